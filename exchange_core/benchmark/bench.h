@@ -0,0 +1,63 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <pthread.h>
+#include <vector>
+
+// helpers shared by the benchmark executables
+namespace bench
+{
+  inline void pin(int cpu)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err)
+      fprintf(stderr, "failed to pin to cpu %d: %s\n", cpu, strerror(err));
+  }
+
+  inline int64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // latency samples in ns, percentiles are taken from the sorted samples
+  class Histogram
+  {
+  public:
+    explicit Histogram(size_t capacity)
+    {
+      samples.reserve(capacity);
+    }
+
+    void add(int64_t ns)
+    {
+      samples.push_back(ns);
+    }
+
+    int64_t percentile(double p)
+    {
+      if (samples.empty())
+        return 0;
+      if (!sorted)
+      {
+        std::sort(samples.begin(), samples.end());
+        sorted = true;
+      }
+      return samples[std::min<size_t>(samples.size() - 1, samples.size() * p)];
+    }
+
+    int64_t max()
+    {
+      return percentile(1.0);
+    }
+
+  private:
+    std::vector<int64_t> samples;
+    bool sorted = false;
+  };
+}
@@ -0,0 +1,107 @@
+// Per-update cost of a std::map book vs PriceLadder on a synthetic Phemex-like stream
+// The mid random-walks on BTCUSD's 0.5 tick in priceEp, updates land geometrically distributed around the touch,
+// and every update reads the top of book, as MarketDataService does to refill its OrderBook
+// usage: book_bench [cpu] [updates]
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "exchange-core/PriceLadder.h"
+
+namespace
+{
+  constexpr int64_t TICK = 5000;
+
+  struct Update
+  {
+    bool bid;
+    int64_t price;
+    int64_t qty;
+  };
+
+  std::vector<Update> makeStream(size_t n)
+  {
+    std::mt19937_64 rng(7);
+    std::geometric_distribution<int> depth(0.08);
+    std::vector<Update> ret;
+    ret.reserve(n);
+    int64_t mid = 400000000;
+    for (size_t i = 0; i < n; i++)
+    {
+      if (rng() % 8 == 0)
+        mid += TICK * ((int64_t)(rng() % 3) - 1);
+      bool bid = rng() & 1;
+      int64_t offset = TICK * (1 + depth(rng));
+      ret.push_back(Update{bid, bid ? mid - offset : mid + offset, rng() % 3 ? (int64_t)(rng() % 50000 + 1) : 0});
+    }
+    return ret;
+  }
+
+  // what exchange_phemex::snapshot did
+  struct MapBook
+  {
+    std::map<int64_t, int64_t> bids;
+    std::map<int64_t, int64_t> asks;
+
+    void set(const Update &u)
+    {
+      auto &levels = u.bid ? bids : asks;
+      if (u.qty)
+        levels[u.price] = u.qty;
+      else
+        levels.erase(u.price);
+    }
+
+    int64_t touch()
+    {
+      return (bids.empty() ? 0 : bids.rbegin()->first) + (asks.empty() ? 0 : asks.begin()->first);
+    }
+  };
+
+  struct LadderBook
+  {
+    exchange_core::PriceLadder<> ladder{TICK};
+
+    void set(const Update &u)
+    {
+      ladder.set(u.bid ? exchange_core::Side::BUY : exchange_core::Side::SELL, u.price, u.qty);
+    }
+
+    int64_t touch()
+    {
+      return ladder.bestBid().price + ladder.bestAsk().price;
+    }
+  };
+
+  template <class Book>
+  double run(const std::vector<Update> &stream, int64_t &check)
+  {
+    Book book;
+    int64_t start = bench::now();
+    for (auto &u : stream)
+    {
+      book.set(u);
+      check += book.touch();
+    }
+    return (double)(bench::now() - start) / stream.size();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int cpu = argc > 1 ? atoi(argv[1]) : 0;
+  size_t updates = argc > 2 ? atol(argv[2]) : 10000000;
+  bench::pin(cpu);
+  std::vector<Update> stream = makeStream(updates);
+
+  int64_t map_check = 0, ladder_check = 0;
+  printf("book,ns_per_update\n");
+  printf("std_map,%.2f\n", run<MapBook>(stream, map_check));
+  printf("price_ladder,%.2f\n", run<LadderBook>(stream, ladder_check));
+  if (map_check != ladder_check)
+    fprintf(stderr, "books disagree\n");
+  return 0;
+}
@@ -0,0 +1,87 @@
+// Per-event cost of delivering trades to listeners through virtual calls vs a ListenerChain
+// usage: listener_bench [cpu] [events]
+#include <cstdio>
+#include <cstdlib>
+
+#include "bench.h"
+#include "exchange-core/ListenerChain.h"
+
+namespace
+{
+  // typical per-tick listeners: a little arithmetic each, so the dispatch is a visible share of the cost
+  class VolumeCounter final : public exchange_core::MarketDataEventListener
+  {
+  public:
+    void onOrderBook(const exchange_core::OrderBook &) override {}
+    void onTrade(const exchange_core::FeedTrade &trade) override
+    {
+      volume += trade.quantity.raw();
+    }
+    int64_t volume = 0;
+  };
+
+  class VwapTracker final : public exchange_core::MarketDataEventListener
+  {
+  public:
+    void onOrderBook(const exchange_core::OrderBook &) override {}
+    void onTrade(const exchange_core::FeedTrade &trade) override
+    {
+      notional += trade.price.raw() * trade.quantity.raw();
+      quantity += trade.quantity.raw();
+    }
+    int64_t notional = 0;
+    int64_t quantity = 0;
+  };
+
+  class LastPrice final : public exchange_core::MarketDataEventListener
+  {
+  public:
+    void onOrderBook(const exchange_core::OrderBook &) override {}
+    void onTrade(const exchange_core::FeedTrade &trade) override
+    {
+      last = trade.price;
+    }
+    exchange_core::Price last;
+  };
+
+  // stands in for the service's parser loop
+  template <class Listener>
+  double run(Listener &listener, int64_t events)
+  {
+    exchange_core::FeedTrade trade{};
+    int64_t start = bench::now();
+    for (int64_t i = 0; i < events; i++)
+    {
+      trade.price = exchange_core::Price(400000000 + (i & 1023));
+      trade.quantity = exchange_core::Qty(1 + (i & 7));
+      trade.side = i & 1 ? exchange_core::Side::BUY : exchange_core::Side::SELL;
+      trade.timestamp = i;
+      listener.onTrade(trade);
+    }
+    return (double)(bench::now() - start) / events;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int cpu = argc > 1 ? atoi(argv[1]) : 0;
+  int64_t events = argc > 2 ? atol(argv[2]) : 100000000;
+  bench::pin(cpu);
+
+  VolumeCounter volume;
+  VwapTracker vwap;
+  LastPrice last;
+
+  exchange_core::MarketDataListeners virtuals;
+  virtuals.add(volume);
+  virtuals.add(vwap);
+  virtuals.add(last);
+  exchange_core::ListenerChain<VolumeCounter, VwapTracker, LastPrice> chain(volume, vwap, last);
+
+  printf("dispatch,ns_per_event\n");
+  printf("virtual,%.2f\n", run(virtuals, events));
+  printf("listener_chain,%.2f\n", run(chain, events));
+  // keeps the listeners' work observable
+  fprintf(stderr, "%ld %ld %ld\n", volume.volume, vwap.notional / (vwap.quantity ? vwap.quantity : 1), last.last.raw());
+  return 0;
+}
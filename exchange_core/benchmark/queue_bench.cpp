@@ -0,0 +1,347 @@
+// Throughput and round-trip latency of WFSPSC, WFSPMC and WFMPMC at several payload sizes,
+// between two pinned threads and between two pinned processes sharing the queues through shmmap
+// usage: queue_bench [producer_cpu] [consumer_cpu] [messages] [round_trips]
+// prints one CSV row per queue, notify policy, payload size and mode
+// mode publish times the producer alone, without a consumer and without round trips
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <sys/wait.h>
+#include <thread>
+
+#include "bench.h"
+#include "exchange-core/shm.h"
+#include "exchange-core/WFMPMC.h"
+
+namespace
+{
+  template <size_t N>
+  struct Payload
+  {
+    int64_t seq;
+    int64_t ts;
+    char data[N - 16];
+  };
+
+  constexpr uint32_t QUEUE_SIZE = 4096;
+
+  // Each adapter wraps one queue type in a Channel that lives in shm, with a Producer and a Consumer end
+  // that are used by exactly one thread each
+  // Consumers always spin, the ShmNotifier runs measure what its notify() adds to the producer
+
+  template <class T, class Notify = exchange_core::NoNotify>
+  struct SPSC
+  {
+    static constexpr const char *name = "WFSPSC";
+    static constexpr bool notify = std::is_same<Notify, exchange_core::ShmNotifier>::value;
+
+    struct Channel
+    {
+      exchange_core::WFSPSC<T, QUEUE_SIZE, 16, exchange_core::OverflowPolicy::SPIN, Notify> q;
+
+      bool shmInit()
+      {
+        return q.shmInit();
+      }
+    };
+
+    struct Producer
+    {
+      Channel &ch;
+
+      template <typename F>
+      void push(F f)
+      {
+        ch.q.tryVisitPush([&](T &v)
+                          { f(v); });
+      }
+    };
+
+    struct Consumer
+    {
+      Channel &ch;
+
+      template <typename F>
+      bool tryPop(F f)
+      {
+        return ch.q.tryVisitPop([&](T &&v)
+                                { f(v); });
+      }
+    };
+  };
+
+  template <class T, class Notify = exchange_core::NoNotify>
+  struct SPMC
+  {
+    static constexpr const char *name = "WFSPMC";
+    static constexpr bool notify = std::is_same<Notify, exchange_core::ShmNotifier>::value;
+
+    // WFSPMC never waits for readers, the reader reports its progress so the producer doesn't lap it
+    struct Channel
+    {
+      exchange_core::WFSPMC<T, QUEUE_SIZE, 16, Notify> q;
+      alignas(64) std::atomic<int64_t> consumed;
+
+      bool shmInit()
+      {
+        return q.shmInit();
+      }
+    };
+
+    struct Producer
+    {
+      Channel &ch;
+
+      template <typename F>
+      void push(F f)
+      {
+        while (ch.q.getCurrentWriteIdx() + 1 - ch.consumed.load(std::memory_order_acquire) > QUEUE_SIZE / 2)
+          exchange_core::cpuRelax();
+        ch.q.tryVisitPush([&](T &v)
+                          { f(v); });
+      }
+    };
+
+    struct Consumer
+    {
+      Channel &ch;
+      int64_t idx = 1;
+
+      template <typename F>
+      bool tryPop(F f)
+      {
+        if (ch.q.tryVisitPop([&](T &&v)
+                             { f(v); },
+                             idx) != exchange_core::ReadResult::OK)
+          return false;
+        if ((++idx & 63) == 0)
+          ch.consumed.store(idx, std::memory_order_release);
+        return true;
+      }
+    };
+  };
+
+  template <class T, class Notify = exchange_core::NoNotify>
+  struct MPMC
+  {
+    static constexpr const char *name = "WFMPMC";
+    static constexpr bool notify = std::is_same<Notify, exchange_core::ShmNotifier>::value;
+
+    using Queue = exchange_core::WFMPMC<T, QUEUE_SIZE, 16, Notify>;
+
+    struct Channel
+    {
+      Queue q;
+
+      bool shmInit()
+      {
+        return q.shmInit();
+      }
+    };
+
+    struct Producer
+    {
+      Channel &ch;
+      typename Queue::Handle *handle = ch.q.registerHandle();
+
+      template <typename F>
+      void push(F f)
+      {
+        while (!ch.q.tryVisitPush(handle, [&](T &v)
+                                  { f(v); }))
+          exchange_core::cpuRelax();
+      }
+    };
+
+    struct Consumer
+    {
+      Channel &ch;
+      typename Queue::Handle *handle = ch.q.registerHandle();
+
+      template <typename F>
+      bool tryPop(F f)
+      {
+        return ch.q.tryVisitPop(handle, [&](T &&v)
+                                { f(v); });
+      }
+    };
+  };
+
+  template <class A>
+  struct Segment
+  {
+    typename A::Channel ping;
+    typename A::Channel pong;
+
+    bool shmInit()
+    {
+      return ping.shmInit() && pong.shmInit();
+    }
+  };
+
+  struct Result
+  {
+    double throughput;
+    bench::Histogram rtt;
+  };
+
+  // consumer side: drains the throughput run, acks it, then echoes every round trip
+  template <class A, class T>
+  void echo(Segment<A> &seg, int64_t messages, int64_t round_trips)
+  {
+    typename A::Consumer in{seg.ping};
+    typename A::Producer out{seg.pong};
+
+    int64_t expect = 0;
+    for (int64_t i = 0; i < messages; i++)
+    {
+      while (!in.tryPop([&](T &v)
+                        {
+                          if (v.seq != ++expect)
+                          {
+                            fprintf(stderr, "%s: out of order %ld != %ld\n", A::name, v.seq, expect);
+                            exit(1);
+                          }
+                        }))
+        ;
+    }
+    out.push([&](T &v)
+             { v.seq = expect; });
+
+    for (int64_t i = 0; i < round_trips; i++)
+    {
+      int64_t ts = 0;
+      while (!in.tryPop([&](T &v)
+                        { ts = v.ts; }))
+        ;
+      out.push([&](T &v)
+               { v.ts = ts; });
+    }
+  }
+
+  // producer side
+  template <class A, class T>
+  void drive(Segment<A> &seg, int64_t messages, int64_t round_trips, Result &result)
+  {
+    typename A::Producer out{seg.ping};
+    typename A::Consumer in{seg.pong};
+
+    int64_t start = bench::now();
+    for (int64_t i = 1; i <= messages; i++)
+    {
+      out.push([&](T &v)
+               { v.seq = i; });
+    }
+    while (!in.tryPop([](T &) {}))
+      ;
+    result.throughput = messages * 1e9 / (bench::now() - start);
+
+    for (int64_t i = 0; i < round_trips; i++)
+    {
+      out.push([&](T &v)
+               { v.ts = bench::now(); });
+      int64_t ts = 0;
+      while (!in.tryPop([&](T &v)
+                        { ts = v.ts; }))
+        ;
+      result.rtt.add(bench::now() - ts);
+    }
+  }
+
+  template <class A, class T>
+  void run(bool processes, int producer_cpu, int consumer_cpu, int64_t messages, int64_t round_trips)
+  {
+    static int runs = 0;
+    std::string name = "/exchange_core_queue_bench_" + std::to_string(getpid()) + "_" + std::to_string(runs++);
+    auto *seg = exchange_core::shmmap<Segment<A>>(name);
+    exchange_core::shmremove(name);
+    if (!seg)
+      return;
+
+    Result result{0, bench::Histogram(round_trips)};
+    if (processes)
+    {
+      pid_t pid = fork();
+      if (pid == 0)
+      {
+        bench::pin(consumer_cpu);
+        echo<A, T>(*seg, messages, round_trips);
+        _exit(0);
+      }
+      bench::pin(producer_cpu);
+      drive<A, T>(*seg, messages, round_trips, result);
+      waitpid(pid, nullptr, 0);
+    }
+    else
+    {
+      std::thread consumer([&]
+                           {
+                             bench::pin(consumer_cpu);
+                             echo<A, T>(*seg, messages, round_trips);
+                           });
+      bench::pin(producer_cpu);
+      drive<A, T>(*seg, messages, round_trips, result);
+      consumer.join();
+    }
+    exchange_core::shmunmap(seg);
+
+    printf("%s,%s,%zu,%s,%ld,%.0f,%ld,%ld,%ld,%ld\n", A::name, A::notify ? "shm" : "none", sizeof(T),
+           processes ? "process" : "thread", messages,
+           result.throughput, result.rtt.percentile(0.5), result.rtt.percentile(0.99), result.rtt.percentile(0.999),
+           result.rtt.max());
+    fflush(stdout);
+  }
+
+  // producer alone on overwriting queues, what a publish costs with and without the notifier
+  template <class Q, class T>
+  void runPublish(const char *name, bool notify, int producer_cpu, int64_t messages)
+  {
+    auto q = std::make_unique<Q>();
+    bench::pin(producer_cpu);
+    int64_t start = bench::now();
+    for (int64_t i = 1; i <= messages; i++)
+      q->tryVisitPush([&](T &v)
+                      { v.seq = i; });
+    double throughput = messages * 1e9 / (bench::now() - start);
+    printf("%s,%s,%zu,publish,%ld,%.0f,0,0,0,0\n", name, notify ? "shm" : "none", sizeof(T), messages, throughput);
+    fflush(stdout);
+  }
+
+  template <size_t N>
+  void runAll(int producer_cpu, int consumer_cpu, int64_t messages, int64_t round_trips)
+  {
+    using T = Payload<N>;
+    using exchange_core::NoNotify;
+    using exchange_core::OverflowPolicy;
+    using exchange_core::ShmNotifier;
+    runPublish<exchange_core::WFSPSC<T, QUEUE_SIZE, 16, OverflowPolicy::OVERWRITE, NoNotify>, T>("WFSPSC", false, producer_cpu, messages);
+    runPublish<exchange_core::WFSPSC<T, QUEUE_SIZE, 16, OverflowPolicy::OVERWRITE, ShmNotifier>, T>("WFSPSC", true, producer_cpu, messages);
+    runPublish<exchange_core::WFSPMC<T, QUEUE_SIZE, 16, NoNotify>, T>("WFSPMC", false, producer_cpu, messages);
+    runPublish<exchange_core::WFSPMC<T, QUEUE_SIZE, 16, ShmNotifier>, T>("WFSPMC", true, producer_cpu, messages);
+    for (bool processes : {false, true})
+    {
+      run<SPSC<T>, T>(processes, producer_cpu, consumer_cpu, messages, round_trips);
+      run<SPMC<T>, T>(processes, producer_cpu, consumer_cpu, messages, round_trips);
+      run<MPMC<T>, T>(processes, producer_cpu, consumer_cpu, messages, round_trips);
+      run<SPSC<T, exchange_core::ShmNotifier>, T>(processes, producer_cpu, consumer_cpu, messages, round_trips);
+      run<SPMC<T, exchange_core::ShmNotifier>, T>(processes, producer_cpu, consumer_cpu, messages, round_trips);
+      run<MPMC<T, exchange_core::ShmNotifier>, T>(processes, producer_cpu, consumer_cpu, messages, round_trips);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int producer_cpu = argc > 1 ? atoi(argv[1]) : 0;
+  int consumer_cpu = argc > 2 ? atoi(argv[2]) : 1;
+  int64_t messages = argc > 3 ? atol(argv[3]) : 10000000;
+  int64_t round_trips = argc > 4 ? atol(argv[4]) : 100000;
+
+  printf("queue,notify,payload_bytes,mode,messages,throughput_msgs_per_sec,rtt_p50_ns,rtt_p99_ns,rtt_p999_ns,rtt_max_ns\n");
+  runAll<64>(producer_cpu, consumer_cpu, messages, round_trips);
+  runAll<256>(producer_cpu, consumer_cpu, messages, round_trips);
+  runAll<1024>(producer_cpu, consumer_cpu, messages, round_trips);
+  return 0;
+}
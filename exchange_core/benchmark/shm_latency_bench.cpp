@@ -0,0 +1,77 @@
+// Push-to-pop latency percentiles of a Queue-sized shm ring with and without huge pages
+// usage: shm_latency_bench [producer_cpu] [consumer_cpu] [messages]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "bench.h"
+#include "exchange-core/shm.h"
+
+namespace
+{
+  // Queue's element and size, bounded so the producer can't lap the consumer
+  using LatencyQueue = exchange_core::WFSPSC<exchange_core::Message, 1024 * 16, 16, exchange_core::OverflowPolicy::SPIN>;
+
+  void run(const char *config, const exchange_core::ShmOptions &options, int producer_cpu, int consumer_cpu, int64_t messages)
+  {
+    std::string name = "/exchange_core_latency_bench_" + std::to_string(getpid());
+    size_t size = 0;
+    auto *q = exchange_core::shmmap<LatencyQueue>(name, options, &size);
+    if (!q)
+      return;
+    q->reset();
+
+    bench::Histogram latencies(messages);
+    std::thread consumer([&]
+                         {
+                           bench::pin(consumer_cpu);
+                           for (int64_t i = 0; i < messages; i++)
+                           {
+                             q->waitVisitPop<exchange_core::BusySpinWait>([&](exchange_core::Message &&msg)
+                                                                          { latencies.add(bench::now() - msg.seq); });
+                           }
+                         });
+
+    bench::pin(producer_cpu);
+    for (int64_t i = 0; i < messages; i++)
+    {
+      // one message in flight at a time, spaced out so every sample walks a fresh part of the 16 MB ring
+      while (q->size() > 0)
+        ;
+      int64_t start = bench::now();
+      while (bench::now() - start < 1000)
+        ;
+      q->tryVisitPush([&](exchange_core::Message &msg)
+                      {
+                        msg.message_type = exchange_core::MessageType::BBO;
+                        msg.seq = bench::now();
+                      });
+    }
+    consumer.join();
+
+    exchange_core::shmunmap(q, size);
+    exchange_core::shmremove(name, options);
+
+    printf("%s,%ld,%ld,%ld,%ld\n", config, latencies.percentile(0.5), latencies.percentile(0.99),
+           latencies.percentile(0.999), latencies.max());
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int producer_cpu = argc > 1 ? atoi(argv[1]) : 0;
+  int consumer_cpu = argc > 2 ? atoi(argv[2]) : 1;
+  int64_t messages = argc > 3 ? atol(argv[3]) : 100000;
+
+  exchange_core::ShmOptions regular;
+  exchange_core::ShmOptions huge;
+  huge.hugePages = true;
+  huge.prefault = true;
+  huge.lock = true;
+
+  printf("config,p50_ns,p99_ns,p999_ns,max_ns\n");
+  run("4k_pages", regular, producer_cpu, consumer_cpu, messages);
+  run("huge_pages_prefault_mlock", huge, producer_cpu, consumer_cpu, messages);
+  return 0;
+}
@@ -0,0 +1,84 @@
+// Per-message cost of WFSPSC single vs batched publish/consume across two pinned cores
+// usage: spsc_batch_bench [producer_cpu] [consumer_cpu] [messages]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+#include "bench.h"
+#include "exchange-core/WFSPSC.h"
+
+namespace
+{
+  struct Payload
+  {
+    int64_t seq;
+    char data[56];
+  };
+
+  constexpr uint32_t QUEUE_SIZE = 4096;
+  using Queue = exchange_core::WFSPSC<Payload, QUEUE_SIZE>;
+
+  double run(uint32_t batch, int producer_cpu, int consumer_cpu, int64_t messages)
+  {
+    auto q = std::make_unique<Queue>();
+
+    std::thread consumer([&]
+                         {
+                           bench::pin(consumer_cpu);
+                           int64_t expect = 0;
+                           while (expect < messages)
+                           {
+                             q->tryVisitPopBatch([&](Payload *vals, uint32_t cnt)
+                                                 {
+                                                   for (uint32_t i = 0; i < cnt; i++)
+                                                   {
+                                                     if (vals[i].seq != ++expect)
+                                                     {
+                                                       fprintf(stderr, "out of order: %ld != %ld\n", vals[i].seq, expect);
+                                                       exit(1);
+                                                     }
+                                                   }
+                                                 },
+                                                 batch);
+                           }
+                         });
+
+    bench::pin(producer_cpu);
+    auto start = std::chrono::steady_clock::now();
+    int64_t seq = 0;
+    while (seq < messages)
+    {
+      uint32_t n = std::min<int64_t>(batch, messages - seq);
+      // WFSPSC overwrites unread slots, so keep the producer from lapping the consumer
+      while (q->getCurrentWriteIdx() + n - q->getCurrentReadIdx() > QUEUE_SIZE)
+        ;
+      q->tryVisitPushBatch([&](Payload *vals, uint32_t cnt)
+                           {
+                             for (uint32_t i = 0; i < cnt; i++)
+                               vals[i].seq = ++seq;
+                           },
+                           n);
+    }
+    consumer.join();
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / messages;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  int producer_cpu = argc > 1 ? atoi(argv[1]) : 0;
+  int consumer_cpu = argc > 2 ? atoi(argv[2]) : 1;
+  int64_t messages = argc > 3 ? atol(argv[3]) : 10000000;
+
+  printf("batch,ns_per_msg\n");
+  for (uint32_t batch : {1, 8, 64})
+  {
+    printf("%u,%.2f\n", batch, run(batch, producer_cpu, consumer_cpu, messages));
+  }
+  return 0;
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "message.h"
+
+namespace exchange_core
+{
+  // Rebuilds one instrument's full depth from BookDeltaMessage and BookSnapshotMessage
+  // Levels are kept in sorted flat vectors, best price first: books are shallow and updated near the top, where a
+  // vector beats a node-based map. A delta that skips a book_seq makes the book STALE until the next complete
+  // snapshot; deltas up to the snapshot's book_seq are ignored after it
+  class BookBuilder
+  {
+  public:
+    enum class State
+    {
+      EMPTY,
+      LIVE,
+      STALE
+    };
+
+    struct Level
+    {
+      int64_t price;
+      int64_t quantity;
+    };
+
+    State getState() const
+    {
+      return state;
+    }
+
+    // book_seq of the last delta applied, or of the last snapshot
+    int64_t getBookSeq() const
+    {
+      return book_seq;
+    }
+
+    const std::vector<Level> &getBids() const
+    {
+      return bids;
+    }
+
+    const std::vector<Level> &getAsks() const
+    {
+      return asks;
+    }
+
+    // an empty, live book at seq, e.g. for the producer that applies its own deltas to serve snapshots
+    void clear(int64_t seq = 0)
+    {
+      bids.clear();
+      asks.clear();
+      book_seq = seq;
+      state = State::LIVE;
+    }
+
+    // returns false if the delta was not applied because the book is not live or the delta skipped a book_seq
+    bool onDelta(const BookDeltaMessage &msg)
+    {
+      if (state != State::LIVE || msg.book_seq <= book_seq)
+        return false;
+      if (msg.book_seq != book_seq + 1)
+      {
+        state = State::STALE;
+        return false;
+      }
+      for (uint16_t i = 0; i < msg.cnt; i++)
+        apply(msg.levels[i]);
+      book_seq = msg.book_seq;
+      return true;
+    }
+
+    // returns true once the last chunk of a snapshot made the book live
+    bool onSnapshot(const BookSnapshotMessage &msg)
+    {
+      if (msg.chunk == 0)
+      {
+        pending_bids.clear();
+        pending_asks.clear();
+        pending_seq = msg.book_seq;
+        next_chunk = 0;
+      }
+      // a chunk of another snapshot, or one missed
+      if (msg.chunk != next_chunk || msg.book_seq != pending_seq)
+      {
+        next_chunk = -1;
+        return false;
+      }
+      for (uint16_t i = 0; i < msg.cnt; i++)
+      {
+        auto &level = msg.levels[i];
+        (level.side == Side::BUY ? pending_bids : pending_asks).push_back(Level{level.price, level.quantity});
+      }
+      if (++next_chunk < msg.chunk_cnt)
+        return false;
+      if (state == State::LIVE && pending_seq <= book_seq)
+        return false;
+      bids.swap(pending_bids);
+      asks.swap(pending_asks);
+      std::sort(bids.begin(), bids.end(), [](const Level &a, const Level &b)
+                { return a.price > b.price; });
+      std::sort(asks.begin(), asks.end(), [](const Level &a, const Level &b)
+                { return a.price < b.price; });
+      book_seq = pending_seq;
+      state = State::LIVE;
+      next_chunk = -1;
+      return true;
+    }
+
+    // Encodes the book into snapshot chunks for consumers that join late or fell behind
+    // Visitor's signature: void f(const BookSnapshotMessage& chunk)
+    template <typename Visitor>
+    void makeSnapshot(BookSnapshotMessage &msg, Visitor v) const
+    {
+      size_t total = bids.size() + asks.size();
+      msg.book_seq = book_seq;
+      msg.chunk_cnt = std::max<size_t>(1, (total + BookSnapshotMessage::MAX_LEVELS - 1) / BookSnapshotMessage::MAX_LEVELS);
+      for (size_t i = 0, chunk = 0; chunk < msg.chunk_cnt; chunk++)
+      {
+        uint16_t n = 0;
+        for (; n < BookSnapshotMessage::MAX_LEVELS && i < total; n++, i++)
+        {
+          bool bid = i < bids.size();
+          auto &level = bid ? bids[i] : asks[i - bids.size()];
+          msg.levels[n] = BookLevel{level.price, level.quantity, bid ? Side::BUY : Side::SELL, {}};
+        }
+        msg.chunk = chunk;
+        msg.setCount(n);
+        v(msg);
+      }
+    }
+
+  private:
+    void apply(const BookLevel &level)
+    {
+      if (level.side == Side::BUY)
+        update(bids, level, [](int64_t a, int64_t b)
+               { return a > b; });
+      else
+        update(asks, level, [](int64_t a, int64_t b)
+               { return a < b; });
+    }
+
+    template <typename Better>
+    static void update(std::vector<Level> &levels, const BookLevel &level, Better better)
+    {
+      auto it = std::lower_bound(levels.begin(), levels.end(), level.price, [&](const Level &l, int64_t price)
+                                 { return better(l.price, price); });
+      bool found = it != levels.end() && it->price == level.price;
+      if (!level.quantity)
+      {
+        if (found)
+          levels.erase(it);
+      }
+      else if (found)
+        it->quantity = level.quantity;
+      else
+        levels.insert(it, Level{level.price, level.quantity});
+    }
+
+    State state = State::EMPTY;
+    int64_t book_seq = 0;
+    std::vector<Level> bids;
+    std::vector<Level> asks;
+
+    std::vector<Level> pending_bids;
+    std::vector<Level> pending_asks;
+    int64_t pending_seq = 0;
+    int next_chunk = -1;
+  };
+}
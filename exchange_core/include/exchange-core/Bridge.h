@@ -0,0 +1,587 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "message.h"
+#include "WFSPMC.h"
+
+// Republishes a MulticastQueue off-host
+// BridgePublisher drains the queue, stamps each message's MessageHeader::seq with its queue idx and packs as many
+// messages as fit into each UDP datagram. It also serves a TCP retransmit channel straight from the queue, so a
+// BridgeReceiver that sees a gap in seq fetches the missing messages as long as the queue hasn't overwritten them.
+// Both sides poll UDP with runOnce(), which never blocks; TCP retransmits run on a thread of their own on either
+// side, so a late joiner catching up doesn't stall the live stream
+
+namespace exchange_core
+{
+  namespace bridge
+  {
+    // fits an Ethernet MTU without IP fragmentation
+    constexpr size_t MAX_DATAGRAM = 1472;
+
+    // a retransmit peer that stalls this long on a send or receive is dropped
+    constexpr int RETRANSMIT_TIMEOUT_MS = 1000;
+
+    // TCP retransmit request: messages [from, to]
+    struct Request
+    {
+      int64_t from;
+      int64_t to;
+    };
+
+    // TCP retransmit reply, followed by cnt messages starting at first; first > from if the queue has lapped them
+    struct Reply
+    {
+      int64_t first;
+      int64_t cnt;
+    };
+
+    inline bool sockaddrOf(const std::string &host, uint16_t port, sockaddr_in &addr)
+    {
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)
+      {
+        std::cerr << "invalid address " << host << std::endl;
+        return false;
+      }
+      return true;
+    }
+
+    inline void setTimeouts(int fd)
+    {
+      timeval tv{RETRANSMIT_TIMEOUT_MS / 1000, RETRANSMIT_TIMEOUT_MS % 1000 * 1000};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    }
+
+    inline bool writeFull(int fd, const void *buf, size_t len)
+    {
+      auto *p = static_cast<const char *>(buf);
+      while (len)
+      {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+          if (n < 0 && errno == EINTR)
+            continue;
+          return false;
+        }
+        p += n;
+        len -= n;
+      }
+      return true;
+    }
+
+    inline bool readFull(int fd, void *buf, size_t len)
+    {
+      auto *p = static_cast<char *>(buf);
+      while (len)
+      {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0)
+        {
+          if (n < 0 && errno == EINTR)
+            continue;
+          return false;
+        }
+        p += n;
+        len -= n;
+      }
+      return true;
+    }
+
+    // message_size bytes of a message, or 0 if it's malformed
+    inline size_t messageSize(const MessageHeader &msg, size_t avail)
+    {
+      size_t size = msg.message_size;
+      return size >= sizeof(MessageHeader) && size <= sizeof(Message) && size <= avail ? size : 0;
+    }
+  }
+
+  template <class Q>
+  class BridgePublisher
+  {
+  public:
+    ~BridgePublisher()
+    {
+      close();
+    }
+
+    // publishes q's messages from the next one on to group:port, which may be a multicast group or a unicast address
+    // iface selects the interface to send multicast from, e.g. "127.0.0.1" for loopback
+    // an already open publisher is closed first
+    bool open(Q *q, const std::string &group, uint16_t port, uint16_t tcpPort, const std::string &iface = "0.0.0.0")
+    {
+      close();
+      this->q = q;
+      next_idx = q->getCurrentWriteIdx() + 1;
+      in_addr ifaddr;
+      if (!bridge::sockaddrOf(group, port, dest) || inet_pton(AF_INET, iface.c_str(), &ifaddr) != 1)
+        return false;
+
+      udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+      if (udp == -1)
+      {
+        std::cerr << "socket failed: " << strerror(errno) << std::endl;
+        return false;
+      }
+      if (IN_MULTICAST(ntohl(dest.sin_addr.s_addr)))
+      {
+        int loop = 1;
+        setsockopt(udp, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr));
+        setsockopt(udp, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+      }
+
+      sockaddr_in addr;
+      bridge::sockaddrOf(iface, tcpPort, addr);
+      int on = 1;
+      listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      if (listener == -1 || bind(listener, (sockaddr *)&addr, sizeof(addr)) || listen(listener, 16))
+      {
+        std::cerr << "retransmit listener on port " << tcpPort << " failed: " << strerror(errno) << std::endl;
+        close();
+        return false;
+      }
+      serving = true;
+      retransmitter = std::thread([this]
+                                  { serveRetransmits(); });
+      return true;
+    }
+
+    void close()
+    {
+      serving = false;
+      if (retransmitter.joinable())
+        retransmitter.join();
+      for (int fd : clients)
+        ::close(fd);
+      clients.clear();
+      if (udp != -1)
+        ::close(udp);
+      if (listener != -1)
+        ::close(listener);
+      udp = listener = -1;
+    }
+
+    // sends what has been published since the last call, returns the number of messages sent
+    int64_t runOnce()
+    {
+      return publish();
+    }
+
+    // messages the publisher itself couldn't read before the queue overwrote them
+    int64_t getLostCount()
+    {
+      return lost;
+    }
+
+  private:
+    int64_t publish()
+    {
+      int64_t cnt = 0;
+      size_t len = 0;
+      int64_t write_idx = q->getCurrentWriteIdx();
+      while (next_idx <= write_idx)
+      {
+        if (q->getOldestIdx() > next_idx)
+        {
+          lost += q->getOldestIdx() - next_idx;
+          next_idx = q->getOldestIdx();
+          continue;
+        }
+        if (len + sizeof(Message) > sizeof(buf))
+          flush(len);
+        size_t size = 0;
+        ReadResult res = copy(buf + len, next_idx, size);
+        if (res == ReadResult::NOT_READY)
+          break;
+        if (res == ReadResult::LAPPED || !size)
+        {
+          // overwritten before or while copying, or malformed
+          lost++;
+          next_idx++;
+          continue;
+        }
+        len += size;
+        next_idx++;
+        cnt++;
+      }
+      flush(len);
+      return cnt;
+    }
+
+    // copies idx into p with seq stamped, size is 0 if the message is malformed
+    ReadResult copy(char *p, int64_t idx, size_t &size)
+    {
+      ReadResult res = q->tryVisitPop([&](Message &&msg)
+                                      {
+                                        size = bridge::messageSize(msg, sizeof(Message));
+                                        memcpy(p, &msg, size); },
+                                      idx);
+      if (res == ReadResult::OK && size)
+        reinterpret_cast<MessageHeader *>(p)->seq = idx;
+      return res;
+    }
+
+    void flush(size_t &len)
+    {
+      if (!len)
+        return;
+      // a datagram dropped here is a gap to the receivers, who recover it over TCP
+      sendto(udp, buf, len, 0, (sockaddr *)&dest, sizeof(dest));
+      len = 0;
+    }
+
+    // the retransmit thread, reads the queue alongside publish() but never writes to it
+    void serveRetransmits()
+    {
+      std::vector<pollfd> fds;
+      while (serving.load(std::memory_order_relaxed))
+      {
+        fds.assign(1, pollfd{listener, POLLIN, 0});
+        for (int fd : clients)
+          fds.push_back(pollfd{fd, POLLIN, 0});
+        // wakes up now and then to notice close()
+        if (poll(fds.data(), fds.size(), 100) <= 0)
+          continue;
+        for (size_t i = clients.size(); i-- > 0;)
+        {
+          bridge::Request req;
+          if (!fds[i + 1].revents ||
+              ((fds[i + 1].revents & POLLIN) && bridge::readFull(clients[i], &req, sizeof(req)) && retransmit(clients[i], req)))
+            continue;
+          ::close(clients[i]);
+          clients.erase(clients.begin() + i);
+        }
+        int fd;
+        while ((fd = accept(listener, nullptr, nullptr)) != -1)
+        {
+          int on = 1;
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+          bridge::setTimeouts(fd);
+          clients.push_back(fd);
+        }
+      }
+    }
+
+    bool retransmit(int fd, const bridge::Request &req)
+    {
+      bridge::Reply reply;
+      reply.first = std::max(req.from, q->getOldestIdx());
+      int64_t to = std::min(req.to, q->getCurrentWriteIdx());
+      reply.cnt = std::max<int64_t>(0, to - reply.first + 1);
+      std::vector<char> out(sizeof(reply));
+      for (int64_t idx = reply.first; idx <= to; idx++)
+      {
+        size_t len = out.size();
+        out.resize(len + sizeof(Message));
+        size_t size = 0;
+        ReadResult res = copy(out.data() + len, idx, size);
+        out.resize(res == ReadResult::OK ? len + size : len);
+        if (res != ReadResult::OK || !size)
+        {
+          // lapped while copying, everything up to idx is gone; a malformed message is skipped the same way
+          out.resize(sizeof(reply));
+          reply.first = idx + 1;
+          reply.cnt = std::max<int64_t>(0, to - idx);
+        }
+      }
+      memcpy(out.data(), &reply, sizeof(reply));
+      return bridge::writeFull(fd, out.data(), out.size());
+    }
+
+    Q *q = nullptr;
+    int64_t next_idx = 1;
+    int64_t lost = 0;
+    int udp = -1;
+    int listener = -1;
+    sockaddr_in dest;
+    std::vector<int> clients;
+    std::atomic<bool> serving{false};
+    std::thread retransmitter;
+    alignas(8) char buf[bridge::MAX_DATAGRAM];
+  };
+
+  template <class Q>
+  class BridgeReceiver
+  {
+  public:
+    ~BridgeReceiver()
+    {
+      close();
+    }
+
+    // rebuilds the publisher's queue in q, in seq order
+    // startSeq 0 starts at whatever arrives first, otherwise messages from startSeq on are fetched over TCP,
+    // e.g. 1 for a late joiner that wants everything the publisher still has
+    // While a gap is being fetched, runOnce() keeps draining UDP and holds what arrives until the gap is filled
+    // an already open receiver is closed first
+    bool open(Q *q, const std::string &group, uint16_t port, const std::string &publisher, uint16_t tcpPort,
+              int64_t startSeq = 0, const std::string &iface = "0.0.0.0")
+    {
+      close();
+      this->q = q;
+      next_seq = startSeq;
+      sockaddr_in addr;
+      if (!bridge::sockaddrOf(publisher, tcpPort, retransmit_addr) || !bridge::sockaddrOf(group, port, addr))
+        return false;
+
+      udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+      int on = 1;
+      setsockopt(udp, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+      // large enough to absorb a burst between two runOnce() calls
+      int rcvbuf = 8 * 1024 * 1024;
+      setsockopt(udp, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+      bool multicast = IN_MULTICAST(ntohl(addr.sin_addr.s_addr));
+      if (!multicast)
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      if (udp == -1 || bind(udp, (sockaddr *)&addr, sizeof(addr)))
+      {
+        std::cerr << "udp bind on port " << port << " failed: " << strerror(errno) << std::endl;
+        close();
+        return false;
+      }
+      if (multicast)
+      {
+        ip_mreq mreq;
+        mreq.imr_multiaddr = addr.sin_addr;
+        inet_pton(AF_INET, iface.c_str(), &mreq.imr_interface);
+        if (setsockopt(udp, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)))
+        {
+          std::cerr << "joining " << group << " failed: " << strerror(errno) << std::endl;
+          close();
+          return false;
+        }
+      }
+      stopping = requested = recovering = false;
+      recovered = false;
+      pending.clear();
+      recoverer = std::thread([this]
+                              { serveRecoveries(); });
+      return true;
+    }
+
+    void close()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+      }
+      cv.notify_one();
+      if (recoverer.joinable())
+        recoverer.join();
+      if (udp != -1)
+        ::close(udp);
+      udp = -1;
+    }
+
+    // processes every datagram that has arrived and a finished recovery, returns the number of messages pushed into q
+    int64_t runOnce()
+    {
+      int64_t cnt = 0;
+      if (recovering && recovered.load(std::memory_order_acquire))
+        cnt += finishRecovery();
+      ssize_t len;
+      while ((len = recv(udp, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      {
+        for (size_t off = 0, size; off < (size_t)len; off += size)
+        {
+          auto &msg = *reinterpret_cast<MessageHeader *>(buf + off);
+          if (!(size = bridge::messageSize(msg, len - off)))
+            break;
+          cnt += handle(msg, size);
+        }
+      }
+      return cnt;
+    }
+
+    // next seq expected from the publisher
+    int64_t getNextSeq()
+    {
+      return next_seq;
+    }
+
+    int64_t getGapCount()
+    {
+      return gaps;
+    }
+
+    // messages that could be recovered neither from UDP nor TCP
+    int64_t getLostCount()
+    {
+      return lost;
+    }
+
+  private:
+    void push(const MessageHeader &msg, size_t size)
+    {
+      q->tryVisitPush([&](Message &data)
+                      { memcpy(&data, &msg, size); });
+      next_seq = msg.seq + 1;
+    }
+
+    // pushes msg if it's the next in seq, holds it while a gap before it is being fetched, drops it if it's old
+    int64_t handle(const MessageHeader &msg, size_t size)
+    {
+      if (!recovering && next_seq && msg.seq > next_seq)
+      {
+        gaps++;
+        {
+          std::lock_guard<std::mutex> lock(mtx);
+          request = {next_seq, msg.seq - 1};
+          requested = true;
+        }
+        cv.notify_one();
+        recovering = true;
+      }
+      if (recovering)
+      {
+        auto *p = reinterpret_cast<const char *>(&msg);
+        pending.insert(pending.end(), p, p + size);
+        return 0;
+      }
+      if (next_seq && msg.seq != next_seq)
+        return 0;
+      push(msg, size);
+      return 1;
+    }
+
+    // pushes what the recovery thread fetched, skipping what the publisher no longer had, then the held messages
+    int64_t finishRecovery()
+    {
+      int64_t cnt = 0;
+      lost += fetched_first - request.from;
+      next_seq = fetched_first;
+      for (size_t off = 0; off < fetched.size(); cnt++)
+      {
+        auto &msg = *reinterpret_cast<MessageHeader *>(&fetched[off]);
+        push(msg, msg.message_size);
+        off += msg.message_size;
+      }
+      // the publisher had already lost the end of the range
+      lost += request.to + 1 - next_seq;
+      next_seq = request.to + 1;
+      recovered.store(false, std::memory_order_relaxed);
+      recovering = false;
+
+      // a held message may reveal another gap, the ones after it are held again
+      held.swap(pending);
+      pending.clear();
+      for (size_t off = 0; off < held.size();)
+      {
+        auto &msg = *reinterpret_cast<MessageHeader *>(&held[off]);
+        cnt += handle(msg, msg.message_size);
+        off += msg.message_size;
+      }
+      return cnt;
+    }
+
+    // the recovery thread, fetches one requested gap at a time over a TCP connection it keeps open
+    void serveRecoveries()
+    {
+      int tcp = -1;
+      std::unique_lock<std::mutex> lock(mtx);
+      while (true)
+      {
+        cv.wait(lock, [this]
+                { return stopping || requested; });
+        if (stopping)
+          break;
+        requested = false;
+        bridge::Request req = request;
+        lock.unlock();
+        fetch(tcp, req);
+        recovered.store(true, std::memory_order_release);
+        lock.lock();
+      }
+      if (tcp != -1)
+        ::close(tcp);
+    }
+
+    // fetches [from, to] into fetched, fetched_first being the first seq the publisher still had
+    void fetch(int &tcp, const bridge::Request &req)
+    {
+      fetched.clear();
+      fetched_first = req.to + 1;
+      if (tcp == -1)
+      {
+        tcp = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(tcp, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        bridge::setTimeouts(tcp);
+        if (connect(tcp, (sockaddr *)&retransmit_addr, sizeof(retransmit_addr)))
+        {
+          std::cerr << "retransmit connect failed: " << strerror(errno) << std::endl;
+          ::close(tcp);
+          tcp = -1;
+          return;
+        }
+      }
+      bridge::Reply reply;
+      if (!bridge::writeFull(tcp, &req, sizeof(req)) || !bridge::readFull(tcp, &reply, sizeof(reply)))
+      {
+        ::close(tcp);
+        tcp = -1;
+        return;
+      }
+      fetched_first = reply.first;
+      for (int64_t i = 0; i < reply.cnt; i++)
+      {
+        Message msg;
+        if (!bridge::readFull(tcp, &msg, sizeof(MessageHeader)) || !bridge::messageSize(msg, sizeof(Message)) ||
+            !bridge::readFull(tcp, reinterpret_cast<char *>(&msg) + sizeof(MessageHeader), msg.message_size - sizeof(MessageHeader)))
+        {
+          // keeps the messages read so far, the rest of the range is lost
+          ::close(tcp);
+          tcp = -1;
+          return;
+        }
+        auto *p = reinterpret_cast<const char *>(&msg);
+        fetched.insert(fetched.end(), p, p + msg.message_size);
+      }
+    }
+
+    Q *q = nullptr;
+    int64_t next_seq = 0;
+    int64_t gaps = 0;
+    int64_t lost = 0;
+    int udp = -1;
+    sockaddr_in retransmit_addr;
+    alignas(8) char buf[bridge::MAX_DATAGRAM];
+
+    // runOnce() side of the recovery, a single gap is fetched at a time
+    bool recovering = false;
+    std::vector<char> pending;
+    std::vector<char> held;
+
+    // handed over to the recovery thread under mtx
+    std::thread recoverer;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stopping = false;
+    bool requested = false;
+    bridge::Request request;
+
+    // handed back by the recovery thread, owned by runOnce() once recovered is set
+    std::atomic<bool> recovered{false};
+    std::vector<char> fetched;
+    int64_t fetched_first = 0;
+  };
+}
@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <time.h>
+#include <spdlog/spdlog.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace exchange_core
+{
+  // CPU timestamp counter, or the monotonic clock in ns where there is none
+  inline uint64_t rdtsc()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+  }
+
+  inline int64_t clockNs(clockid_t id)
+  {
+    timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+  }
+
+  // Wall-clock time from rdtsc, a few ns per read instead of a vDSO call, that never goes backwards
+  // The ticks are anchored to CLOCK_MONOTONIC, at a rate measured against it, plus the CLOCK_REALTIME offset
+  // taken at init(). calibrate() refines the rate over the whole time since init() and slews the offset toward
+  // the current one by at most MAX_SLEW_PPM, as adjtime() would, so an NTP step is followed gradually; the new
+  // anchor is never below what the previous one gives. Call it every second or so off the hot path, e.g. from a
+  // TscCalibrator
+  class TscClock
+  {
+  public:
+    // how fast calibrate() moves now() toward CLOCK_REALTIME, in ns per second
+    static constexpr int64_t MAX_SLEW_PPM = 500;
+
+    // measures the tick rate over calibrateNs
+    void init(int64_t calibrateNs = 10000000)
+    {
+      if (!invariant())
+        spdlog::warn("the TSC of this CPU is not invariant, TscClock may drift");
+      Sample start = sample();
+      Sample end;
+      do
+        end = sample();
+      while (end.mono - start.mono < calibrateNs);
+      first = start;
+      last = end;
+      offset = end.real - end.mono;
+      publish(end, ((unsigned __int128)(end.mono - start.mono) << 32) / (end.tsc - start.tsc));
+    }
+
+    // ns since epoch
+    int64_t now() const
+    {
+      return fromTicks(rdtsc());
+    }
+
+    // ns since epoch at the time rdtsc() returned ticks
+    int64_t fromTicks(uint64_t ticks) const
+    {
+      for (;;)
+      {
+        uint32_t s = seq.load(std::memory_order_acquire);
+        uint64_t base_tsc = this->base_tsc.load(std::memory_order_relaxed);
+        int64_t base_ns = this->base_ns.load(std::memory_order_relaxed);
+        uint64_t mult = this->mult.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(s & 1) && seq.load(std::memory_order_relaxed) == s)
+          return base_ns + (int64_t)(((__int128)(int64_t)(ticks - base_tsc) * mult) >> 32);
+      }
+    }
+
+    // ns between two rdtsc() readings, for latency measurements
+    int64_t toNs(uint64_t ticks) const
+    {
+      return (int64_t)(((unsigned __int128)ticks * mult.load(std::memory_order_relaxed)) >> 32);
+    }
+
+    // corrects the drift against the system clocks; a no-op if another thread is calibrating
+    void calibrate()
+    {
+      Sample cur = sample();
+      if (cur.tsc == first.tsc)
+        return;
+      publish(cur, ((unsigned __int128)(cur.mono - first.mono) << 32) / (cur.tsc - first.tsc));
+    }
+
+    // CLOCK_REALTIME - CLOCK_MONOTONIC as now() currently follows it
+    int64_t getOffset() const
+    {
+      return offset;
+    }
+
+    // ns per tick
+    double getNsPerTick() const
+    {
+      return (double)mult.load(std::memory_order_relaxed) / (1ull << 32);
+    }
+
+    static bool invariant()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+      unsigned eax, ebx, ecx, edx;
+      return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8));
+#else
+      return true;
+#endif
+    }
+
+  private:
+    struct Sample
+    {
+      uint64_t tsc;
+      int64_t mono;
+      int64_t real;
+    };
+
+    // the tsc is taken halfway through reading the system clocks, the tightest of a few attempts wins
+    static Sample sample()
+    {
+      Sample ret{};
+      uint64_t best = UINT64_MAX;
+      for (int i = 0; i < 5; i++)
+      {
+        uint64_t before = rdtsc();
+        int64_t mono = clockNs(CLOCK_MONOTONIC);
+        int64_t real = clockNs(CLOCK_REALTIME);
+        uint64_t after = rdtsc();
+        if (after - before < best)
+        {
+          best = after - before;
+          ret = Sample{before + (after - before) / 2, mono, real};
+        }
+      }
+      return ret;
+    }
+
+    // anchors the conversion at the time of publishing, continuing from the previous one if that is ahead
+    void publish(const Sample &s, uint64_t mult)
+    {
+      uint32_t cur = seq.load(std::memory_order_relaxed);
+      if ((cur & 1) || !seq.compare_exchange_strong(cur, cur + 1, std::memory_order_acquire))
+        return;
+      std::atomic_thread_fence(std::memory_order_release);
+      int64_t max_slew = (s.mono - last.mono) / (1000000 / MAX_SLEW_PPM);
+      offset += std::clamp(s.real - s.mono - offset, -max_slew, max_slew);
+      last = s;
+      // readers that got their ticks before this one still convert them with the previous parameters
+      uint64_t ticks = rdtsc();
+      int64_t prev = base_ns.load(std::memory_order_relaxed) +
+                     (int64_t)(((__int128)(int64_t)(ticks - base_tsc.load(std::memory_order_relaxed)) * this->mult.load(std::memory_order_relaxed)) >> 32);
+      int64_t next = s.mono + offset + (int64_t)(((__int128)(int64_t)(ticks - s.tsc) * mult) >> 32);
+      base_tsc.store(ticks, std::memory_order_relaxed);
+      base_ns.store(std::max(prev, next), std::memory_order_relaxed);
+      this->mult.store(mult, std::memory_order_relaxed);
+      seq.store(cur + 2, std::memory_order_release);
+    }
+
+    Sample first{};
+    // only touched while holding the seqlock
+    Sample last{};
+    int64_t offset = 0;
+    // seqlock over the conversion below, odd while calibrate() updates it
+    std::atomic<uint32_t> seq{0};
+    std::atomic<uint64_t> base_tsc{0};
+    std::atomic<int64_t> base_ns{0};
+    // ns per tick in 32.32 fixed point
+    std::atomic<uint64_t> mult{0};
+  };
+
+  // Calls calibrate() on a TscClock every intervalNs from its own thread, so the threads reading the clock
+  // never pay for sampling the system clocks
+  class TscCalibrator
+  {
+  public:
+    explicit TscCalibrator(TscClock &clock, int64_t intervalNs = 1000000000)
+        : thread([this, &clock, intervalNs]
+                 {
+                   std::unique_lock<std::mutex> lock(mutex);
+                   while (!cv.wait_for(lock, std::chrono::nanoseconds(intervalNs), [this]
+                                       { return stop; }))
+                     clock.calibrate();
+                 })
+    {
+    }
+
+    ~TscCalibrator()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      cv.notify_one();
+      thread.join();
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop = false;
+    // last, so it starts after the members it uses
+    std::thread thread;
+  };
+
+  // the process wide TscClock, calibrated on first use and every second after by a TscCalibrator
+  inline TscClock &tscClock()
+  {
+    static TscClock *clock = []
+    {
+      auto *ret = new TscClock();
+      ret->init();
+      return ret;
+    }();
+    static TscCalibrator calibrator(*clock);
+    return *clock;
+  }
+
+  // A now() read once per event loop iteration with update(), for the timer checks in between
+  // It doesn't calibrate the clock, tscClock() has a TscCalibrator for that
+  class CoarseClock
+  {
+  public:
+    explicit CoarseClock(TscClock &clock = tscClock())
+        : clock(clock)
+    {
+      update();
+    }
+
+    int64_t update()
+    {
+      ns = clock.now();
+      return ns;
+    }
+
+    // ns since epoch as of the last update()
+    int64_t nowNs() const
+    {
+      return ns;
+    }
+
+    int64_t nowMs() const
+    {
+      return ns / 1000000;
+    }
+
+  private:
+    TscClock &clock;
+    int64_t ns = 0;
+  };
+}
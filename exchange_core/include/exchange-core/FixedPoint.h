@@ -0,0 +1,57 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+
+namespace exchange_core
+{
+  // Fixed point value in units of its instrument's scale, e.g. Phemex's priceEp with a price scale of 10000
+  // Compare and arithmetic stay integer, doubles only come in and out at the boundaries with the instrument's scale
+  template <class Tag>
+  class FixedPoint
+  {
+  public:
+    constexpr FixedPoint() : value(0) {}
+    constexpr explicit FixedPoint(int64_t raw) : value(raw) {}
+
+    static FixedPoint fromDouble(double val, int64_t scale) { return FixedPoint(std::llround(val * scale)); }
+    double toDouble(int64_t scale) const { return (double)value / scale; }
+    constexpr int64_t raw() const { return value; }
+
+    constexpr bool operator==(FixedPoint other) const { return value == other.value; }
+    constexpr bool operator!=(FixedPoint other) const { return value != other.value; }
+    constexpr bool operator<(FixedPoint other) const { return value < other.value; }
+    constexpr bool operator<=(FixedPoint other) const { return value <= other.value; }
+    constexpr bool operator>(FixedPoint other) const { return value > other.value; }
+    constexpr bool operator>=(FixedPoint other) const { return value >= other.value; }
+
+    constexpr FixedPoint operator+(FixedPoint other) const { return FixedPoint(value + other.value); }
+    constexpr FixedPoint operator-(FixedPoint other) const { return FixedPoint(value - other.value); }
+    constexpr FixedPoint operator-() const { return FixedPoint(-value); }
+    constexpr FixedPoint operator*(int64_t n) const { return FixedPoint(value * n); }
+    FixedPoint &operator+=(FixedPoint other)
+    {
+      value += other.value;
+      return *this;
+    }
+    FixedPoint &operator-=(FixedPoint other)
+    {
+      value -= other.value;
+      return *this;
+    }
+
+  private:
+    int64_t value;
+  };
+
+  template <class Tag>
+  std::ostream &operator<<(std::ostream &os, FixedPoint<Tag> val)
+  {
+    return os << val.raw();
+  }
+
+  struct PriceTag;
+  struct QtyTag;
+  using Price = FixedPoint<PriceTag>;
+  using Qty = FixedPoint<QtyTag>;
+}
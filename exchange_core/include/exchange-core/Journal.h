@@ -0,0 +1,343 @@
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "Clock.h"
+#include "ShmHeader.h"
+
+namespace exchange_core
+{
+  // Append-only, file-backed variant of WFSPMC for tick capture
+  // idx starts at 1 and grows forever, idx lives in segment (idx - 1) / SEG_SIZE, a file named
+  // <dir>/<name>.<segment>.journal, so readers can tail a live journal or read it long after the writer is gone
+  // Every slot carries the capture time of its message
+  template <class T, uint32_t SEG_SIZE = 1024 * 64>
+  struct JournalSegment
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "journaled types must be trivially copyable");
+
+    // bumped whenever the file layout of this class changes
+    static constexpr uint32_t LAYOUT_VERSION = 1;
+
+    bool shmInit()
+    {
+      return header.attach("JOURNAL", LAYOUT_VERSION, sizeof(T), SEG_SIZE);
+    }
+
+    ShmHeader header;
+    // last idx published into this segment, 0 if none
+    alignas(64) std::atomic<int64_t> write_idx;
+    struct
+    {
+      // idx once published, 0 before
+      std::atomic<int64_t> seq;
+      // capture time, ns since epoch
+      int64_t ts;
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+    } blks[SEG_SIZE];
+
+    static std::string path(const std::string &dir, const std::string &name, int64_t seg)
+    {
+      char buf[32];
+      snprintf(buf, sizeof(buf), ".%06ld.journal", seg);
+      return dir + "/" + name + buf;
+    }
+
+    // maps a segment file, creating it if create is set; nullptr if it doesn't exist or holds another layout
+    static JournalSegment *map(const std::string &path, bool create)
+    {
+      int fd = open(path.c_str(), create ? O_CREAT | O_RDWR : O_RDWR, 0644);
+      if (fd == -1)
+      {
+        if (create)
+          std::cerr << "open " << path << " failed: " << strerror(errno) << std::endl;
+        return nullptr;
+      }
+      struct stat st;
+      if (!create && fstat(fd, &st) == 0 && !st.st_size)
+      {
+        // the writer is just creating it
+        close(fd);
+        return nullptr;
+      }
+      if (fstat(fd, &st) || (st.st_size && (size_t)st.st_size != sizeof(JournalSegment)))
+      {
+        std::cerr << path << " is not a journal segment of this layout" << std::endl;
+        close(fd);
+        return nullptr;
+      }
+      // allocate the blocks up front, so the writer's page faults don't have to, and only size the file
+      // where the filesystem can't
+      if (create && !st.st_size && posix_fallocate(fd, 0, sizeof(JournalSegment)) && ftruncate(fd, sizeof(JournalSegment)))
+      {
+        std::cerr << "ftruncate " << path << " failed: " << strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+      }
+      auto *ret = (JournalSegment *)mmap(0, sizeof(JournalSegment), PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | (create ? MAP_POPULATE : 0), fd, 0);
+      close(fd);
+      if (ret == MAP_FAILED)
+      {
+        std::cerr << "mmap " << path << " failed: " << strerror(errno) << std::endl;
+        return nullptr;
+      }
+      if (!ret->shmInit())
+      {
+        munmap(ret, sizeof(JournalSegment));
+        return nullptr;
+      }
+      return ret;
+    }
+
+    static void unmap(JournalSegment *seg)
+    {
+      if (seg)
+        munmap(seg, sizeof(JournalSegment));
+    }
+  };
+
+  // The single writer of a journal
+  // The hot path makes no syscalls as long as maintain() is called off it, e.g. whenever the writer is idle:
+  // it creates the next segment once the current one is half full and unmaps the previous one
+  template <class T, uint32_t SEG_SIZE = 1024 * 64>
+  class JournalWriter
+  {
+  public:
+    using Segment = JournalSegment<T, SEG_SIZE>;
+
+    JournalWriter() = default;
+    JournalWriter(const JournalWriter &) = delete;
+    JournalWriter &operator=(const JournalWriter &) = delete;
+
+    ~JournalWriter()
+    {
+      Segment::unmap(prev);
+      Segment::unmap(cur);
+      Segment::unmap(next);
+    }
+
+    // opens the journal, resuming after its last published idx if it exists
+    bool open(const std::string &dir, const std::string &name)
+    {
+      this->dir = dir;
+      this->name = name;
+      int64_t seg = 0;
+      while (access(Segment::path(dir, name, seg + 1).c_str(), F_OK) == 0)
+        seg++;
+      cur = Segment::map(Segment::path(dir, name, seg), true);
+      if (!cur)
+        return false;
+      // the newest segment may be one maintain() created ahead of time and never published to, resume in
+      // the one before it and keep it as the next
+      if (seg > 0 && !cur->write_idx.load(std::memory_order_acquire))
+      {
+        Segment *prev_seg = Segment::map(Segment::path(dir, name, seg - 1), false);
+        if (prev_seg)
+        {
+          next = cur;
+          cur = prev_seg;
+          seg--;
+        }
+      }
+      cur_seg = seg;
+      write_idx = cur->write_idx.load(std::memory_order_acquire);
+      if (!write_idx)
+        write_idx = seg * SEG_SIZE;
+      return true;
+    }
+
+    int64_t getCurrentWriteIdx()
+    {
+      return write_idx;
+    }
+
+    // if successful, the returned pointer points to an *unconstructed* object that user should construct himself
+    // returns nullptr only if the next segment can't be created
+    T *getWritable(int64_t idx)
+    {
+      int64_t seg = (idx - 1) / SEG_SIZE;
+      if (seg != cur_seg && !roll(seg))
+        return nullptr;
+      return reinterpret_cast<T *>(&cur->blks[(idx - 1) % SEG_SIZE].data);
+    }
+
+    // stamps the slot with the capture time and publishes it
+    void commitWrite(int64_t idx)
+    {
+      auto &blk = cur->blks[(idx - 1) % SEG_SIZE];
+      blk.ts = tscClock().now();
+      blk.seq.store(idx, std::memory_order_release);
+      cur->write_idx.store(idx, std::memory_order_release);
+      write_idx = idx;
+    }
+
+    // Lounger(All in One) version of write, which is neither wait-free nor zero-copy
+    template <typename... Args>
+    bool emplace(Args &&...args)
+    {
+      int64_t idx = write_idx + 1;
+      T *data = getWritable(idx);
+      if (!data)
+        return false;
+      new (data) T(std::forward<Args>(args)...);
+      commitWrite(idx);
+      return true;
+    }
+
+    // zero-copy
+    // Visitor's signature: void f(T& val), where val is an *unconstructed* object
+    template <typename Visitor>
+    bool tryVisitPush(Visitor v)
+    {
+      int64_t idx = write_idx + 1;
+      T *data = getWritable(idx);
+      if (!data)
+        return false;
+      v(*data);
+      commitWrite(idx);
+      return true;
+    }
+
+    template <typename Type>
+    bool tryPush(Type &&val)
+    {
+      return tryVisitPush(
+          [val = std::forward<decltype(val)>(val)](T &data) { new (&data) T(std::forward<decltype(val)>(val)); });
+    }
+
+    // housekeeping the hot path relies on, call it when idle
+    void maintain()
+    {
+      if (prev)
+      {
+        Segment::unmap(prev);
+        prev = nullptr;
+      }
+      if (!next && (write_idx - 1) % SEG_SIZE >= SEG_SIZE / 2)
+        next = Segment::map(Segment::path(dir, name, cur_seg + 1), true);
+    }
+
+  private:
+    bool roll(int64_t seg)
+    {
+      if (!next)
+        next = Segment::map(Segment::path(dir, name, seg), true);
+      if (!next)
+        return false;
+      Segment::unmap(prev);
+      prev = cur;
+      cur = next;
+      next = nullptr;
+      cur_seg = seg;
+      return true;
+    }
+
+    std::string dir;
+    std::string name;
+    int64_t write_idx = 0;
+    int64_t cur_seg = 0;
+    Segment *prev = nullptr;
+    Segment *cur = nullptr;
+    Segment *next = nullptr;
+  };
+
+  // Any number of readers, live or after the fact, read a journal by idx
+  // Reading doesn't disturb the writer, a reader only maps the segment its current idx lives in
+  template <class T, uint32_t SEG_SIZE = 1024 * 64>
+  class JournalReader
+  {
+  public:
+    using Segment = JournalSegment<T, SEG_SIZE>;
+
+    JournalReader() = default;
+    JournalReader(const JournalReader &) = delete;
+    JournalReader &operator=(const JournalReader &) = delete;
+
+    ~JournalReader()
+    {
+      Segment::unmap(cur);
+    }
+
+    // returns false if the journal has no segment yet
+    bool open(const std::string &dir, const std::string &name)
+    {
+      this->dir = dir;
+      this->name = name;
+      cur_seg = -1;
+      return getSegment(0) != nullptr;
+    }
+
+    // zero-copy
+    // Visitor's signature: void f(const T& val)
+    // returns false without calling v if idx is not published yet
+    template <typename Visitor>
+    bool tryVisitPop(Visitor v, int64_t idx)
+    {
+      auto *blk = getBlk(idx);
+      if (!blk)
+        return false;
+      v(reinterpret_cast<const T &>(blk->data));
+      return true;
+    }
+
+    bool tryRead(T &out, int64_t idx)
+    {
+      return tryVisitPop([&](const T &val)
+                         { out = val; },
+                         idx);
+    }
+
+    // capture time of idx in ns since epoch, 0 if idx is not published yet
+    int64_t getTimestamp(int64_t idx)
+    {
+      auto *blk = getBlk(idx);
+      return blk ? blk->ts : 0;
+    }
+
+    // last idx published so far, as seen from the segment of idx
+    int64_t getCurrentWriteIdx(int64_t idx)
+    {
+      Segment *seg = getSegment((idx - 1) / SEG_SIZE);
+      return seg ? seg->write_idx.load(std::memory_order_acquire) : 0;
+    }
+
+  private:
+    auto *getBlk(int64_t idx)
+    {
+      using Blk = typename std::remove_reference<decltype(Segment::blks[0])>::type;
+      Segment *seg = idx > 0 ? getSegment((idx - 1) / SEG_SIZE) : nullptr;
+      if (!seg)
+        return (Blk *)nullptr;
+      auto *blk = &seg->blks[(idx - 1) % SEG_SIZE];
+      return blk->seq.load(std::memory_order_acquire) == idx ? blk : nullptr;
+    }
+
+    Segment *getSegment(int64_t seg)
+    {
+      if (seg != cur_seg)
+      {
+        // the writer may not have created it yet
+        Segment *s = Segment::map(Segment::path(dir, name, seg), false);
+        if (!s)
+          return nullptr;
+        Segment::unmap(cur);
+        cur = s;
+        cur_seg = seg;
+      }
+      return cur;
+    }
+
+    std::string dir;
+    std::string name;
+    int64_t cur_seg = -1;
+    Segment *cur = nullptr;
+  };
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "exchange-core.h"
+
+namespace exchange_core
+{
+  // The listeners of a service as a compile-time list, for services templated on their listener, e.g.
+  // exchange_phemex::BasicMarketDataService<ListenerChain<Strategy, Recorder>>
+  // Every event goes to the listeners in order through direct, inlinable calls; listeners only implement the
+  // callbacks they care about, the others are skipped at compile time. Listeners are held by reference
+  template <class... Listeners>
+  class ListenerChain
+  {
+  public:
+    explicit ListenerChain(Listeners &...listeners)
+        : listeners(listeners...)
+    {
+    }
+
+    void onOrderBook(const OrderBook &orderBook)
+    {
+      each([&](auto &l) -> decltype(l.onOrderBook(orderBook))
+           { l.onOrderBook(orderBook); });
+    }
+
+    void onTrade(const FeedTrade &trade)
+    {
+      each([&](auto &l) -> decltype(l.onTrade(trade))
+           { l.onTrade(trade); });
+    }
+
+    void onExecutionReport(const ExecutionReport &executionReport)
+    {
+      each([&](auto &l) -> decltype(l.onExecutionReport(executionReport))
+           { l.onExecutionReport(executionReport); });
+    }
+
+    void onBalanceReport(const BalanceReport &balanceReport)
+    {
+      each([&](auto &l) -> decltype(l.onBalanceReport(balanceReport))
+           { l.onBalanceReport(balanceReport); });
+    }
+
+    template <size_t I>
+    auto &get()
+    {
+      return std::get<I>(listeners);
+    }
+
+  private:
+    template <class F>
+    void each(F f)
+    {
+      std::apply([&](auto &...l)
+                 { (call(l, f), ...); },
+                 listeners);
+    }
+
+    template <class L, class F>
+    static void call(L &l, F &f)
+    {
+      if constexpr (std::is_invocable<F &, L &>::value)
+        f(l);
+    }
+
+    std::tuple<Listeners &...> listeners;
+  };
+
+  // Adaptors putting the virtual listeners registered at runtime into a chain, or behind a templated service;
+  // they are what the services' RegisterListener() feeds
+  class MarketDataListeners
+  {
+  public:
+    void add(MarketDataEventListener &listener)
+    {
+      listeners.push_back(&listener);
+    }
+
+    void onOrderBook(const OrderBook &orderBook)
+    {
+      for (auto *l : listeners)
+        l->onOrderBook(orderBook);
+    }
+
+    void onTrade(const FeedTrade &trade)
+    {
+      for (auto *l : listeners)
+        l->onTrade(trade);
+    }
+
+  private:
+    std::vector<MarketDataEventListener *> listeners;
+  };
+
+  class TradeListeners
+  {
+  public:
+    void add(TradeEventListener &listener)
+    {
+      listeners.push_back(&listener);
+    }
+
+    void onExecutionReport(const ExecutionReport &executionReport)
+    {
+      for (auto *l : listeners)
+        l->onExecutionReport(executionReport);
+    }
+
+    void onBalanceReport(const BalanceReport &balanceReport)
+    {
+      for (auto *l : listeners)
+        l->onBalanceReport(balanceReport);
+    }
+
+  private:
+    std::vector<TradeEventListener *> listeners;
+  };
+
+  template <class L, class V, class = void>
+  struct CanAddListener : std::false_type
+  {
+  };
+
+  template <class L, class V>
+  struct CanAddListener<L, V, std::void_t<decltype(std::declval<L &>().add(std::declval<V &>()))>> : std::true_type
+  {
+  };
+
+  // registers a virtual listener with listeners that take them at runtime, returns false for a fixed chain
+  template <class L, class V>
+  bool addListener(L &listeners, V &listener)
+  {
+    if constexpr (CanAddListener<L, V>::value)
+    {
+      listeners.add(listener);
+      return true;
+    }
+    else
+    {
+      (void)listeners;
+      (void)listener;
+      return false;
+    }
+  }
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include "message.h"
+
+namespace exchange_core
+{
+  // Message type id, the message_size range a message struct may arrive with and valid(), the checks of its
+  // contents that make it safe to read
+  template <class M>
+  struct MessageTraits;
+
+#define EXCHANGE_CORE_MESSAGE_TRAITS(M, TYPE)          \
+  template <>                                          \
+  struct MessageTraits<M>                              \
+  {                                                    \
+    static constexpr uint16_t type = MessageType::TYPE; \
+    static constexpr size_t min_size = sizeof(M);      \
+    static constexpr size_t max_size = sizeof(M);      \
+    static bool valid(const M &)                       \
+    {                                                  \
+      return true;                                     \
+    }                                                  \
+  };
+
+  EXCHANGE_CORE_MESSAGE_TRAITS(TradeMessage, Trade)
+  EXCHANGE_CORE_MESSAGE_TRAITS(BBOMessage, BBO)
+  EXCHANGE_CORE_MESSAGE_TRAITS(LoginMessage, LOGIN)
+  EXCHANGE_CORE_MESSAGE_TRAITS(LogOffMessage, LOGOFF)
+  EXCHANGE_CORE_MESSAGE_TRAITS(NewOrderMessage, NEW_ORDER)
+  EXCHANGE_CORE_MESSAGE_TRAITS(CancelOrderMessage, CANCEL_ORDER)
+  EXCHANGE_CORE_MESSAGE_TRAITS(CancelAllOrderMessage, CANCEL_ALL_ORDER)
+  EXCHANGE_CORE_MESSAGE_TRAITS(GetOpenOrderMessage, GET_OPEN_ORDER)
+  EXCHANGE_CORE_MESSAGE_TRAITS(LoginAcceptMessage, LOGIN_ACCEPT)
+  EXCHANGE_CORE_MESSAGE_TRAITS(ExecutionReportMessage, EXECUTION_REPORT)
+  EXCHANGE_CORE_MESSAGE_TRAITS(BalanceReportMessage, BALANCE_REPORT)
+  EXCHANGE_CORE_MESSAGE_TRAITS(EchoMessage, EECHO)
+  EXCHANGE_CORE_MESSAGE_TRAITS(JsonMessage, JSON)
+  EXCHANGE_CORE_MESSAGE_TRAITS(TradeMessageV2, TRADE_V2)
+  EXCHANGE_CORE_MESSAGE_TRAITS(BBOMessageV2, BBO_V2)
+  EXCHANGE_CORE_MESSAGE_TRAITS(NewOrderMessageV2, NEW_ORDER_V2)
+
+#undef EXCHANGE_CORE_MESSAGE_TRAITS
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+  // book messages only carry their cnt levels, which must all lie within message_size
+  template <class M>
+  struct BookMessageTraits
+  {
+    static constexpr size_t min_size = offsetof(M, levels);
+    static constexpr size_t max_size = sizeof(M);
+    static bool valid(const M &msg)
+    {
+      return msg.cnt <= M::MAX_LEVELS && offsetof(M, levels) + msg.cnt * sizeof(BookLevel) <= msg.message_size;
+    }
+  };
+
+  template <>
+  struct MessageTraits<BookDeltaMessage> : BookMessageTraits<BookDeltaMessage>
+  {
+    static constexpr uint16_t type = MessageType::BOOK_DELTA;
+  };
+
+  template <>
+  struct MessageTraits<BookSnapshotMessage> : BookMessageTraits<BookSnapshotMessage>
+  {
+    static constexpr uint16_t type = MessageType::BOOK_SNAPSHOT;
+  };
+#pragma GCC diagnostic pop
+
+  template <class... Msgs>
+  struct MessageList
+  {
+  };
+
+  using AllMessages = MessageList<TradeMessage, BBOMessage, LoginMessage, LogOffMessage, NewOrderMessage,
+                                  CancelOrderMessage, CancelAllOrderMessage, GetOpenOrderMessage, LoginAcceptMessage,
+                                  ExecutionReportMessage, BalanceReportMessage, EchoMessage, JsonMessage,
+                                  TradeMessageV2, BBOMessageV2, NewOrderMessageV2, BookDeltaMessage,
+                                  BookSnapshotMessage>;
+
+  // Calls the overload of handler(const M&) matching a message's message_type, through a jump table built at
+  // compile time from the overloads Handler has, so there is neither a switch nor a virtual call
+  // Messages are only handed out if message_size is within what their struct allows and MessageTraits::valid()
+  // accepts them; dispatch() returns false for the others, for unknown types and for types Handler has no overload for
+  template <class Handler, class List = AllMessages>
+  class MessageDispatcher;
+
+  template <class Handler, class... Msgs>
+  class MessageDispatcher<Handler, MessageList<Msgs...>>
+  {
+  public:
+    static bool dispatch(const MessageHeader &msg, Handler &handler)
+    {
+      if (msg.message_type >= TABLE_SIZE)
+        return false;
+      Entry entry = table[msg.message_type];
+      return entry && entry(msg, handler);
+    }
+
+    template <class M>
+    static constexpr bool handles()
+    {
+      return std::is_invocable<Handler &, const M &>::value;
+    }
+
+  private:
+    using Entry = bool (*)(const MessageHeader &, Handler &);
+
+    static constexpr size_t TABLE_SIZE = 128;
+
+    template <class M>
+    static bool call(const MessageHeader &msg, Handler &handler)
+    {
+      if (msg.message_size < MessageTraits<M>::min_size || msg.message_size > MessageTraits<M>::max_size)
+        return false;
+      const M &m = reinterpret_cast<const M &>(msg);
+      if (!MessageTraits<M>::valid(m))
+        return false;
+      handler(m);
+      return true;
+    }
+
+    template <class M>
+    static constexpr void add(std::array<Entry, TABLE_SIZE> &ret)
+    {
+      static_assert(MessageTraits<M>::type < TABLE_SIZE, "message type out of the jump table");
+      if constexpr (handles<M>())
+        ret[MessageTraits<M>::type] = &call<M>;
+    }
+
+    static constexpr std::array<Entry, TABLE_SIZE> makeTable()
+    {
+      std::array<Entry, TABLE_SIZE> ret{};
+      (add<Msgs>(ret), ...);
+      return ret;
+    }
+
+    static constexpr std::array<Entry, TABLE_SIZE> table = makeTable();
+  };
+
+  // dispatch(msg, handler) without naming the dispatcher
+  template <class Handler>
+  bool dispatch(const MessageHeader &msg, Handler &handler)
+  {
+    return MessageDispatcher<Handler>::dispatch(msg, handler);
+  }
+}
@@ -0,0 +1,290 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "message.h"
+
+namespace exchange_core
+{
+  // Full depth book of one instrument as a price-indexed ladder
+  // WINDOW ticks around the touch live in flat quantity arrays with a bitmap of the occupied levels, so an update
+  // is an index computation and a store, and the best bid/ask is cached and found again from the bitmap when it
+  // empties. Levels outside the window, or off the tick grid, go to sorted overflow vectors that only deep levels
+  // normally reach. When the touch leaves the window, it is recentered on the mid, moving every level once
+  template <uint32_t WINDOW = 4096>
+  class PriceLadder
+  {
+    static_assert(WINDOW >= 128 && WINDOW % 64 == 0, "WINDOW must be a multiple of 64");
+
+  public:
+    struct Level
+    {
+      int64_t price;
+      int64_t quantity;
+    };
+
+    explicit PriceLadder(int64_t tick = 1)
+        : tick(tick)
+    {
+      clear();
+    }
+
+    void clear()
+    {
+      reset();
+      centered = false;
+    }
+
+    // sets the quantity at price, 0 removes the level
+    void set(Side side, int64_t price, int64_t quantity)
+    {
+      bool bid = side == Side::BUY;
+      Book &b = bid ? bids : asks;
+      int64_t idx;
+      if (toIndex(price, idx))
+      {
+        setIndex(b, bid, idx, quantity);
+        return;
+      }
+      if (quantity && onGrid(price) && movesTouch(bid, price))
+      {
+        recenter(bid, price);
+        if (toIndex(price, idx))
+        {
+          setIndex(b, bid, idx, quantity);
+          return;
+        }
+      }
+      setOverflow(b, bid, price, quantity);
+    }
+
+    // quantity 0 if the side is empty
+    Level bestBid() const
+    {
+      return best(bids, true);
+    }
+
+    Level bestAsk() const
+    {
+      return best(asks, false);
+    }
+
+    int64_t quantity(Side side, int64_t price) const
+    {
+      const Book &b = side == Side::BUY ? bids : asks;
+      int64_t idx;
+      if (toIndex(price, idx))
+        return b.qty[idx];
+      auto it = findOverflow(b.overflow, side == Side::BUY, price);
+      return it != b.overflow.end() && it->price == price ? it->quantity : 0;
+    }
+
+    size_t size(Side side) const
+    {
+      const Book &b = side == Side::BUY ? bids : asks;
+      return b.cnt + b.overflow.size();
+    }
+
+    // visits up to depth levels of a side, best first
+    // Visitor's signature: void f(const Level& level)
+    template <typename Visitor>
+    void visit(Side side, size_t depth, Visitor v) const
+    {
+      bool bid = side == Side::BUY;
+      const Book &b = bid ? bids : asks;
+      int64_t idx = b.best;
+      auto it = b.overflow.begin();
+      for (size_t n = 0; n < depth; n++)
+      {
+        bool in_window = idx >= 0;
+        bool in_overflow = it != b.overflow.end();
+        if (!in_window && !in_overflow)
+          return;
+        int64_t price = in_window ? base + idx * tick : 0;
+        if (in_window && (!in_overflow || better(bid, price, it->price)))
+        {
+          v(Level{price, b.qty[idx]});
+          idx = bid ? (idx ? scanDown(b.bits, idx - 1) : -1) : (idx + 1 < WINDOW ? scanUp(b.bits, idx + 1) : -1);
+        }
+        else
+          v(*it++);
+      }
+    }
+
+    // lowest price the window covers
+    int64_t getBase() const
+    {
+      return base;
+    }
+
+  private:
+    static constexpr uint32_t WORDS = WINDOW / 64;
+
+    struct Book
+    {
+      std::array<int64_t, WINDOW> qty;
+      std::array<uint64_t, WORDS> bits;
+      // index of the best level in the window, -1 if it's empty
+      int64_t best;
+      // levels in the window
+      size_t cnt;
+      // best first
+      std::vector<Level> overflow;
+    };
+
+    void reset()
+    {
+      for (Book *b : {&bids, &asks})
+      {
+        b->qty.fill(0);
+        b->bits.fill(0);
+        b->best = -1;
+        b->cnt = 0;
+        b->overflow.clear();
+      }
+    }
+
+    static bool better(bool bid, int64_t a, int64_t b)
+    {
+      return bid ? a > b : a < b;
+    }
+
+    bool toIndex(int64_t price, int64_t &idx) const
+    {
+      if (!centered || price < base)
+        return false;
+      int64_t d = price - base;
+      idx = d / tick;
+      return idx < WINDOW && idx * tick == d;
+    }
+
+    Level best(const Book &b, bool bid) const
+    {
+      Level ret{0, 0};
+      if (b.best >= 0)
+        ret = Level{base + b.best * tick, b.qty[b.best]};
+      if (!b.overflow.empty() && (!ret.quantity || better(bid, b.overflow.front().price, ret.price)))
+        ret = b.overflow.front();
+      return ret;
+    }
+
+    bool onGrid(int64_t price) const
+    {
+      return !centered || (price - base) % tick == 0;
+    }
+
+    // whether a new level outside the window would be the side's best
+    bool movesTouch(bool bid, int64_t price) const
+    {
+      if (!centered)
+        return true;
+      Level touch = best(bid ? bids : asks, bid);
+      return !touch.quantity || better(bid, price, touch.price);
+    }
+
+    void setIndex(Book &b, bool bid, int64_t idx, int64_t quantity)
+    {
+      int64_t &slot = b.qty[idx];
+      bool had = slot != 0;
+      slot = quantity;
+      if (quantity && !had)
+      {
+        b.bits[idx >> 6] |= 1ull << (idx & 63);
+        b.cnt++;
+        if (b.best < 0 || (bid ? idx > b.best : idx < b.best))
+          b.best = idx;
+      }
+      else if (!quantity && had)
+      {
+        b.bits[idx >> 6] &= ~(1ull << (idx & 63));
+        b.cnt--;
+        if (idx == b.best)
+          b.best = bid ? scanDown(b.bits, idx) : scanUp(b.bits, idx);
+      }
+    }
+
+    // highest occupied index <= from, -1 if none
+    static int64_t scanDown(const std::array<uint64_t, WORDS> &bits, int64_t from)
+    {
+      int64_t w = from >> 6;
+      uint64_t word = bits[w] & (~0ull >> (63 - (from & 63)));
+      while (!word)
+      {
+        if (--w < 0)
+          return -1;
+        word = bits[w];
+      }
+      return w * 64 + 63 - __builtin_clzll(word);
+    }
+
+    // lowest occupied index >= from, -1 if none
+    static int64_t scanUp(const std::array<uint64_t, WORDS> &bits, int64_t from)
+    {
+      int64_t w = from >> 6;
+      uint64_t word = bits[w] & (~0ull << (from & 63));
+      while (!word)
+      {
+        if (++w == WORDS)
+          return -1;
+        word = bits[w];
+      }
+      return w * 64 + __builtin_ctzll(word);
+    }
+
+    static typename std::vector<Level>::const_iterator findOverflow(const std::vector<Level> &levels, bool bid, int64_t price)
+    {
+      return std::lower_bound(levels.begin(), levels.end(), price, [bid](const Level &l, int64_t p)
+                              { return better(bid, l.price, p); });
+    }
+
+    static void setOverflow(Book &b, bool bid, int64_t price, int64_t quantity)
+    {
+      auto it = b.overflow.begin() + (findOverflow(b.overflow, bid, price) - b.overflow.cbegin());
+      bool found = it != b.overflow.end() && it->price == price;
+      if (!quantity)
+      {
+        if (found)
+          b.overflow.erase(it);
+      }
+      else if (found)
+        it->quantity = quantity;
+      else
+        b.overflow.insert(it, Level{price, quantity});
+    }
+
+    // moves the window so that price lands on it, centered on the mid of price and the other side's touch
+    void recenter(bool bid, int64_t price)
+    {
+      Level other = best(bid ? asks : bids, !bid);
+      int64_t center = other.quantity ? price + (other.price - price) / 2 : price;
+      int64_t k = std::clamp<int64_t>((price - center) / tick + WINDOW / 2, 0, WINDOW - 1);
+      scratch.clear();
+      visit(Side::BUY, SIZE_MAX, [&](const Level &l)
+            { scratch.push_back(l); });
+      size_t bid_cnt = scratch.size();
+      visit(Side::SELL, SIZE_MAX, [&](const Level &l)
+            { scratch.push_back(l); });
+      reset();
+      base = price - k * tick;
+      centered = true;
+      for (size_t i = 0; i < scratch.size(); i++)
+      {
+        bool side = i < bid_cnt;
+        Book &b = side ? bids : asks;
+        int64_t idx;
+        if (toIndex(scratch[i].price, idx))
+          setIndex(b, side, idx, scratch[i].quantity);
+        else
+          b.overflow.push_back(scratch[i]);
+      }
+    }
+
+    int64_t tick;
+    int64_t base = 0;
+    bool centered = false;
+    Book bids;
+    Book asks;
+    std::vector<Level> scratch;
+  };
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Journal.h"
+#include "message.h"
+
+namespace exchange_core
+{
+  // Replays captured journals in capture-time order
+  // Several journals, e.g. one per feed, are merged on their capture timestamps; the pace is set by speed:
+  // 1 replays at wall-clock speed, N at N times it, 0 as fast as possible
+  // A journal whose next idx isn't published yet is polled again on every runOnce(). Without follow it ends at the
+  // last idx its writer had published when the replay gets there; with follow it is tailed until the replayer is
+  // destroyed, and messages a lagging writer publishes late are replayed once they show up
+  template <class T, uint32_t SEG_SIZE = 1024 * 64>
+  class Replayer
+  {
+  public:
+    using Reader = JournalReader<T, SEG_SIZE>;
+
+    explicit Replayer(double speed = 1)
+        : speed(speed)
+    {
+    }
+
+    // replays the journal from idx on, returns false if it can't be opened
+    bool add(const std::string &dir, const std::string &name, int64_t idx = 1, bool follow = false)
+    {
+      auto reader = std::make_unique<Reader>();
+      if (!reader->open(dir, name))
+        return false;
+      sources.push_back(Source{std::move(reader), follow});
+      schedule(sources.size() - 1, idx);
+      return true;
+    }
+
+    // nothing left to replay and no followed journal
+    bool done()
+    {
+      poll();
+      return heap.empty() && waiting.empty();
+    }
+
+    // replays the next message if it's due, returns false if it's not or nothing is published yet
+    // Publish's signature: void f(const T& val, int64_t ts), ts being the capture time in ns since epoch
+    template <typename Publish>
+    bool runOnce(Publish publish)
+    {
+      poll();
+      if (heap.empty())
+        return false;
+      Next next = heap.top();
+      if (speed > 0)
+      {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (!start)
+        {
+          start = now;
+          first_ts = next.ts;
+        }
+        if (now - start < (next.ts - first_ts) / speed)
+          return false;
+      }
+      heap.pop();
+      sources[next.source].reader->tryVisitPop([&](const T &val)
+                                               { publish(val, next.ts); },
+                                               next.idx);
+      schedule(next.source, next.idx + 1);
+      return true;
+    }
+
+    // replays everything, sleeping through gaps longer than a millisecond; returns the number of messages replayed
+    // with a followed journal it only returns once the others are exhausted and it is no longer followed, i.e. never
+    template <typename Publish>
+    int64_t run(Publish publish)
+    {
+      int64_t cnt = 0;
+      while (!done())
+      {
+        if (runOnce(publish))
+        {
+          cnt++;
+          continue;
+        }
+        int64_t wait = heap.empty() ? 0 : (int64_t)((heap.top().ts - first_ts) / speed) -
+                                              (std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - start);
+        if (wait > 1000000)
+          std::this_thread::sleep_for(std::chrono::nanoseconds(wait - 1000000));
+        else
+          cpuRelax();
+      }
+      return cnt;
+    }
+
+  private:
+    struct Source
+    {
+      std::unique_ptr<Reader> reader;
+      bool follow;
+    };
+
+    struct Next
+    {
+      int64_t ts;
+      size_t source;
+      int64_t idx;
+
+      // earliest capture time on top, ties go to the journal added first
+      bool operator<(const Next &other) const
+      {
+        return ts != other.ts ? ts > other.ts : source > other.source;
+      }
+    };
+
+    struct Pending
+    {
+      size_t source;
+      int64_t idx;
+    };
+
+    // queues idx of source if it's published, otherwise leaves it to poll()
+    void schedule(size_t source, int64_t idx)
+    {
+      int64_t ts = sources[source].reader->getTimestamp(idx);
+      if (ts)
+        heap.push(Next{ts, source, idx});
+      else
+        waiting.push_back(Pending{source, idx});
+    }
+
+    // moves the waiting journals that have published their next idx to the heap, and drops the ones that ended
+    void poll()
+    {
+      for (size_t i = 0; i < waiting.size();)
+      {
+        Pending p = waiting[i];
+        Reader &reader = *sources[p.source].reader;
+        int64_t ts = reader.getTimestamp(p.idx);
+        if (ts)
+          heap.push(Next{ts, p.source, p.idx});
+        else if (sources[p.source].follow || reader.getCurrentWriteIdx(p.idx) >= p.idx)
+        {
+          i++;
+          continue;
+        }
+        waiting[i] = waiting.back();
+        waiting.pop_back();
+      }
+    }
+
+    double speed;
+    int64_t start = 0;
+    int64_t first_ts = 0;
+    std::vector<Source> sources;
+    std::priority_queue<Next> heap;
+    // journals whose next idx isn't published yet
+    std::vector<Pending> waiting;
+  };
+
+  // Publish for a Replayer<Message>: copies the bytes the message uses into a MulticastQueue
+  template <class Q>
+  auto publishTo(Q &q)
+  {
+    return [&q](const Message &msg, int64_t)
+    {
+      q.tryVisitPush([&](Message &data)
+                     { memcpy(&data, &msg, std::min<size_t>(msg.message_size, sizeof(Message))); });
+    };
+  }
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <new>
+#include "message.h"
+#include "WaitStrategy.h"
+#include "ShmHeader.h"
+
+namespace exchange_core
+{
+  // Variable-length record ring for MessageHeader based messages
+  // Every record starts on a cache line and spans (message_size + 63) / 64 blocks, so a BBOMessage costs
+  // 128 bytes instead of a whole Message slot. A record that would run past the end of the ring is preceded
+  // by a padding record (message_type == PADDING) that sends the reader back to block 0
+  // Notify: NoNotify, or ShmNotifier for a consumer that waits with FutexWait (see WaitStrategy.h)
+  template <uint32_t BYTES, class Notify = NoNotify>
+  class SPSCVarQueue
+  {
+  public:
+    static constexpr uint32_t BLK_SIZE = 64;
+    static constexpr uint32_t BLK_CNT = BYTES / BLK_SIZE;
+    // outside MessageType's range, so neither a message nor a zeroed block reads as padding
+    static constexpr uint16_t PADDING = 0xFFFF;
+
+    static_assert(BLK_CNT && !(BLK_CNT & (BLK_CNT - 1)), "BYTES / 64 must be a power of 2");
+    static_assert(BYTES >= MAX_MESSAGE_SIZE, "BYTES must hold at least one Message");
+    static_assert(MessageType::MESSAGE_TYPE_END <= PADDING, "a message type collides with PADDING");
+
+    // bumped whenever the shm layout of this class changes
+    static constexpr uint32_t LAYOUT_VERSION = 2;
+
+    // shmInit() should only be called for objects allocated in SHM and are zero-initialized
+    // on reattach it validates the layout and keeps the indexes
+    bool shmInit()
+    {
+      return header.attach("VARQ", LAYOUT_VERSION, BLK_SIZE, BLK_CNT);
+    }
+
+    const ShmHeader &shmHeader() const
+    {
+      return header;
+    }
+
+    // number of blocks in use
+    int64_t size()
+    {
+      return write_idx.load(std::memory_order_relaxed) - read_idx.load(std::memory_order_relaxed);
+    }
+
+    // A hint to check if read is likely to wait
+    bool empty()
+    {
+      return size() <= 0;
+    }
+
+    // zero-copy and wait-free, fails if the ring doesn't have room for size bytes
+    // Visitor's signature: void f(MessageHeader* msg), where msg points to size bytes of *unconstructed* storage
+    // and the visitor is expected to set msg->message_size to at most size, a larger one is cut to size
+    // Only the blocks message_size spans are committed, the rest of the reservation is handed out again
+    template <typename Visitor>
+    bool tryVisitPush(uint16_t size, Visitor v)
+    {
+      uint32_t cnt = blocks(size);
+      int64_t idx = write_idx.load(std::memory_order_relaxed);
+      uint32_t pos = idx % BLK_CNT;
+      uint32_t pad = pos + cnt > BLK_CNT ? BLK_CNT - pos : 0;
+      int64_t end = idx + pad + cnt;
+      if (end - cached_read_idx > BLK_CNT)
+      {
+        cached_read_idx = read_idx.load(std::memory_order_acquire);
+        if (end - cached_read_idx > BLK_CNT)
+          return false;
+      }
+      if (pad)
+      {
+        getBlock(pos)->message_type = PADDING;
+        pos = 0;
+      }
+      MessageHeader *msg = getBlock(pos);
+      v(msg);
+      if (msg->message_size > size)
+        msg->message_size = size;
+      write_idx.store(idx + pad + span(*msg), std::memory_order_release);
+      notifier.notify();
+      return true;
+    }
+
+    // not zero-copy, copies message_size bytes of msg
+    bool tryPush(const MessageHeader &msg)
+    {
+      return tryVisitPush(msg.message_size, [&](MessageHeader *data)
+                          { memcpy(data, &msg, msg.message_size); });
+    }
+
+    // zero-copy and wait-free
+    // Visitor's signature: void f(const MessageHeader& msg), where msg is valid for msg.message_size bytes
+    template <typename Visitor>
+    bool tryVisitPop(Visitor v)
+    {
+      int64_t idx = read_idx.load(std::memory_order_relaxed);
+      if (idx >= cached_write_idx)
+      {
+        cached_write_idx = write_idx.load(std::memory_order_acquire);
+        if (idx >= cached_write_idx)
+          return false;
+      }
+      MessageHeader *msg = getBlock(idx % BLK_CNT);
+      if (msg->message_type == PADDING)
+      {
+        // padding is always committed together with the record that follows it
+        idx += BLK_CNT - idx % BLK_CNT;
+        msg = getBlock(0);
+      }
+      v(static_cast<const MessageHeader &>(*msg));
+      read_idx.store(idx + span(*msg), std::memory_order_release);
+      return true;
+    }
+
+    // blocking read, idles with Wait (see WaitStrategy.h) while the queue is empty
+    // Visitor's signature: void f(const MessageHeader& msg)
+    template <class Wait, typename Visitor>
+    void waitVisitPop(Visitor v, Wait w = Wait())
+    {
+      w.wait([&]
+             { return tryVisitPop(v); },
+             notifier);
+    }
+
+  private:
+    static uint32_t blocks(uint32_t size)
+    {
+      return (size + BLK_SIZE - 1) / BLK_SIZE;
+    }
+
+    // blocks a record takes in the ring, the same for the writer and the reader
+    static uint32_t span(const MessageHeader &msg)
+    {
+      return msg.message_size ? blocks(msg.message_size) : 1;
+    }
+
+    MessageHeader *getBlock(uint32_t pos)
+    {
+      return reinterpret_cast<MessageHeader *>(&blks[pos]);
+    }
+
+  private:
+    ShmHeader header;
+
+    // producer's cache line
+    alignas(64) std::atomic<int64_t> write_idx;
+    int64_t cached_read_idx;
+
+    // consumer's cache line
+    alignas(64) std::atomic<int64_t> read_idx;
+    int64_t cached_write_idx;
+
+    Notify notifier;
+
+    struct alignas(64)
+    {
+      uint8_t data[BLK_SIZE];
+    } blks[BLK_CNT];
+  };
+}
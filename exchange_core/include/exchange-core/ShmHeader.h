@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "WaitStrategy.h"
+
+namespace exchange_core
+{
+  // Layout header at the start of every shm queue
+  // The first process to map a zero-initialized segment stamps it with the queue's layout; every later (re)attach,
+  // e.g. a restarted consumer, checks the stamp before trusting the indexes it finds in the segment
+  struct ShmHeader
+  {
+    static constexpr uint32_t MAGIC = 0x51435845; // "EXCQ"
+
+    enum : uint32_t
+    {
+      UNINITIALIZED = 0,
+      INITIALIZING,
+      READY
+    };
+
+    std::atomic<uint32_t> init_state;
+    uint32_t magic;
+    char type[8];
+    uint32_t version;
+    uint32_t elem_size;
+    uint64_t elem_cnt;
+    int64_t create_time;
+
+    // Init's signature: void f(), run once by the process that creates the segment
+    // returns false if the segment holds a different layout, or if its creator died while initializing it
+    template <typename Init>
+    bool attach(const char *name, uint32_t ver, uint32_t size, uint64_t cnt, Init init)
+    {
+      uint32_t state = UNINITIALIZED;
+      if (init_state.compare_exchange_strong(state, INITIALIZING, std::memory_order_acquire))
+      {
+        init();
+        magic = MAGIC;
+        memcpy(type, name, strnlen(name, sizeof(type)));
+        version = ver;
+        elem_size = size;
+        elem_cnt = cnt;
+        create_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        init_state.store(READY, std::memory_order_release);
+        return true;
+      }
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+      while (state == INITIALIZING && std::chrono::steady_clock::now() < deadline)
+      {
+        cpuRelax();
+        state = init_state.load(std::memory_order_acquire);
+      }
+      if (state != READY || magic != MAGIC)
+      {
+        std::cerr << "shm segment is not an initialized " << name << std::endl;
+        return false;
+      }
+      if (strncmp(type, name, sizeof(type)) || version != ver || elem_size != size || elem_cnt != cnt)
+      {
+        std::cerr << "shm layout mismatch: segment has " << std::string(type, strnlen(type, sizeof(type))) << " v" << version
+                  << " of " << elem_cnt << " x " << elem_size << " bytes, expected " << name << " v" << ver
+                  << " of " << cnt << " x " << size << " bytes" << std::endl;
+        return false;
+      }
+      return true;
+    }
+
+    bool attach(const char *name, uint32_t ver, uint32_t size, uint64_t cnt)
+    {
+      return attach(name, ver, size, cnt, [] {});
+    }
+  };
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fnmatch.h>
+#include <signal.h>
+#include "shm.h"
+
+namespace exchange_core
+{
+  // One topic in a TopicRegistry, only meaningful once state is READY
+  struct TopicEntry
+  {
+    enum : uint32_t
+    {
+      FREE = 0,
+      CLAIMED,
+      READY
+    };
+
+    std::atomic<uint32_t> state;
+    char name[64];
+    // shm segment the topic's queue lives in, the name behind a prefix
+    char segment[sizeof("/exchange_core_topic_") - 1 + sizeof(name)];
+    // copied from the queue's ShmHeader
+    char type[8];
+    uint32_t elem_size;
+    uint64_t elem_cnt;
+    // last process that published into the topic, or that claimed it while CLAIMED
+    std::atomic<int32_t> producer_pid;
+    std::atomic<int64_t> create_time;
+
+    // false once the producer has exited without anyone taking the topic over
+    bool alive() const
+    {
+      return alive(producer_pid.load(std::memory_order_acquire));
+    }
+
+    static bool alive(int32_t pid)
+    {
+      return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+    }
+  };
+
+  // Directory of the queues on the shm message bus, itself a shm segment
+  // Topics are never removed, a restarted producer takes its topic over; entries are kept in an open addressing hash
+  // table so two producers registering the same name concurrently end up on the same entry
+  template <uint32_t SIZE>
+  class TopicDirectory
+  {
+  public:
+    static_assert(SIZE && !(SIZE & (SIZE - 1)), "SIZE must be a power of 2");
+
+    // bumped whenever the shm layout of this class changes
+    static constexpr uint32_t LAYOUT_VERSION = 2;
+
+    // how long an entry may stay CLAIMED before its claimer has even recorded its pid
+    static constexpr std::chrono::seconds CLAIM_TIMEOUT{1};
+
+    // shmInit() should only be called for objects allocated in SHM and are zero-initialized
+    bool shmInit()
+    {
+      return header.attach("TOPICS", LAYOUT_VERSION, sizeof(TopicEntry), SIZE);
+    }
+
+    // the shm segment a topic's queue is mapped from
+    static std::string segmentName(const std::string &topic)
+    {
+      std::string ret = "/exchange_core_topic_" + topic;
+      std::replace(ret.begin() + 1, ret.end(), '/', '.');
+      return ret;
+    }
+
+    // creates the topic or, if its producer has exited, takes it over with the calling process as producer
+    // returns nullptr if name is too long, the directory is full, the topic exists with another queue layout or
+    // another live process produces into it
+    TopicEntry *registerTopic(const std::string &name, const ShmHeader &queue)
+    {
+      if (name.empty() || name.size() >= sizeof(TopicEntry::name))
+        return nullptr;
+      TopicEntry *entry = findOrClaim(name, true);
+      if (!entry)
+      {
+        std::cerr << "topic directory full, can't register " << name << std::endl;
+        return nullptr;
+      }
+      if (entry->state.load(std::memory_order_acquire) == TopicEntry::READY)
+      {
+        if (strncmp(entry->type, queue.type, sizeof(entry->type)) || entry->elem_size != queue.elem_size ||
+            entry->elem_cnt != queue.elem_cnt)
+        {
+          std::cerr << "topic " << name << " is registered with another queue layout" << std::endl;
+          return nullptr;
+        }
+        // its queue is single producer
+        int32_t pid = entry->producer_pid.load(std::memory_order_acquire);
+        if (pid != getpid() && (TopicEntry::alive(pid) || !entry->producer_pid.compare_exchange_strong(pid, getpid())))
+        {
+          std::cerr << "topic " << name << " is produced by pid " << pid << std::endl;
+          return nullptr;
+        }
+      }
+      else
+      {
+        std::string segment = segmentName(name);
+        memcpy(entry->segment, segment.c_str(), segment.size() + 1);
+        memcpy(entry->type, queue.type, sizeof(entry->type));
+        entry->elem_size = queue.elem_size;
+        entry->elem_cnt = queue.elem_cnt;
+      }
+      entry->create_time.store(queue.create_time, std::memory_order_relaxed);
+      entry->producer_pid.store(getpid(), std::memory_order_relaxed);
+      entry->state.store(TopicEntry::READY, std::memory_order_release);
+      return entry;
+    }
+
+    const TopicEntry *find(const std::string &name)
+    {
+      if (name.empty() || name.size() >= sizeof(TopicEntry::name))
+        return nullptr;
+      return findOrClaim(name, false);
+    }
+
+    // topics matching a shell wildcard pattern, e.g. "md.phemex.*"
+    std::vector<const TopicEntry *> match(const std::string &pattern)
+    {
+      std::vector<const TopicEntry *> ret;
+      for (auto &entry : entries)
+      {
+        if (entry.state.load(std::memory_order_acquire) == TopicEntry::READY &&
+            fnmatch(pattern.c_str(), entry.name, 0) == 0)
+          ret.push_back(&entry);
+      }
+      return ret;
+    }
+
+  private:
+    static uint32_t hash(const std::string &name)
+    {
+      // FNV-1a
+      uint32_t h = 2166136261u;
+      for (unsigned char c : name)
+        h = (h ^ c) * 16777619u;
+      return h;
+    }
+
+    // a claimed entry is returned in CLAIMED state, its name already set
+    // An entry left CLAIMED by a process that died before publishing it is taken over by the next claimer and
+    // skipped by lookups
+    TopicEntry *findOrClaim(const std::string &name, bool claim)
+    {
+      for (uint32_t i = 0; i < SIZE; i++)
+      {
+        TopicEntry &entry = entries[(hash(name) + i) % SIZE];
+        uint32_t state = entry.state.load(std::memory_order_acquire);
+        if (state == TopicEntry::FREE)
+        {
+          if (!claim)
+            return nullptr;
+          if (entry.state.compare_exchange_strong(state, TopicEntry::CLAIMED, std::memory_order_acquire) &&
+              takeClaim(entry, 0, name))
+            return &entry;
+          state = entry.state.load(std::memory_order_acquire);
+        }
+        // the name is published together with READY
+        auto start = std::chrono::steady_clock::now();
+        bool abandoned = false;
+        while (state == TopicEntry::CLAIMED)
+        {
+          int32_t pid = entry.producer_pid.load(std::memory_order_acquire);
+          if (pid ? !entry.alive() : std::chrono::steady_clock::now() - start > CLAIM_TIMEOUT)
+          {
+            if (claim && takeClaim(entry, pid, name))
+              return &entry;
+            abandoned = !claim;
+            if (abandoned)
+              break;
+          }
+          cpuRelax();
+          state = entry.state.load(std::memory_order_acquire);
+        }
+        if (!abandoned && name == entry.name)
+          return &entry;
+      }
+      return nullptr;
+    }
+
+    // makes the calling process the claimer of a CLAIMED entry, unless another process got to it first
+    static bool takeClaim(TopicEntry &entry, int32_t claimer, const std::string &name)
+    {
+      if (!entry.producer_pid.compare_exchange_strong(claimer, getpid(), std::memory_order_acq_rel))
+        return false;
+      memcpy(entry.name, name.c_str(), name.size() + 1);
+      return true;
+    }
+
+    ShmHeader header;
+    TopicEntry entries[SIZE];
+  };
+
+  using TopicRegistry = TopicDirectory<1024>;
+  // per-instrument or per-exchange topics on many small rings instead of one MulticastQueue
+  using TopicQueue = WFSPMC<Message, 1024>;
+
+  inline TopicRegistry *getTopicRegistry(const std::string &name = "/exchange_core_topics")
+  {
+    return shmmap<TopicRegistry>(name);
+  }
+
+  // maps the topic's queue and registers the calling process as its producer
+  // mappedSize receives the length to shmunmap() the queue with, see shmmap()
+  template <class Q = TopicQueue>
+  Q *publishTopic(TopicRegistry &registry, const std::string &topic, const ShmOptions &options = ShmOptions(),
+                  size_t *mappedSize = nullptr)
+  {
+    size_t size = sizeof(Q);
+    Q *q = shmmap<Q>(TopicRegistry::segmentName(topic), options, &size);
+    if (mappedSize)
+      *mappedSize = size;
+    if (q && !registry.registerTopic(topic, q->shmHeader()))
+    {
+      shmunmap(q, size);
+      return nullptr;
+    }
+    return q;
+  }
+
+  // maps the queue of a registered topic, nullptr if its layout is not Q's
+  template <class Q = TopicQueue>
+  Q *subscribeTopic(const TopicEntry &entry, const ShmOptions &options = ShmOptions(), size_t *mappedSize = nullptr)
+  {
+    return shmmap<Q>(entry.segment, options, mappedSize);
+  }
+
+  // removes the topic's queue from shm, the registry entry stays for a future producer
+  inline void removeTopic(const TopicEntry &entry, const ShmOptions &options = ShmOptions())
+  {
+    shmremove(entry.segment, options);
+  }
+}
@@ -20,23 +20,35 @@ SOFTWARE.
 
 #pragma once
 #include <atomic>
+#include <cstdint>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include "WaitStrategy.h"
+#include "ShmHeader.h"
 
 // THR_SIZE must not be less than the max number of threads using tryPush/tryPop, otherwise they could fail forever
 // It's preferred to set THR_SIZE twice the max number, because THR_SIZE is the size of an open addressing hash table
 // 16 is a good default value for THR_SIZE, as 16 tids fit exactly in a cache line: 16 * 4 = 64
+// Threads that come and go (e.g. a worker pool) should use registerHandle()/unregisterHandle() instead,
+// which recycles slots and skips the tid hashing on every call
 
 namespace exchange_core
 {
-  template <class T, uint32_t SIZE, uint32_t THR_SIZE = 16>
+  // Notify: NoNotify, or ShmNotifier for consumers that wait with FutexWait (see WaitStrategy.h)
+  template <class T, uint32_t SIZE, uint32_t THR_SIZE = 16, class Notify = NoNotify>
   class WFMPMC
   {
+  private:
+    struct ThrIdx;
+
   public:
+    // a registered producer/consumer, see registerHandle()
+    using Handle = ThrIdx;
+
     static_assert(SIZE && !(SIZE & (SIZE - 1)), "SIZE must be a power of 2");
     static_assert(THR_SIZE && !(THR_SIZE & (THR_SIZE - 1)), "THR_SIZE must be a power of 2");
 
-    // must not init init_state in constructor
+    // must not init header in constructor
     WFMPMC()
         : write_idx(0), read_idx(0)
     {
@@ -51,18 +63,19 @@ namespace exchange_core
       }
     }
 
+    // bumped whenever the shm layout of this class changes
+    static constexpr uint32_t LAYOUT_VERSION = 1;
+
     // shmInit() should only be called for objects allocated in SHM and are zero-initialized
-    void shmInit()
+    bool shmInit()
     {
-      int uninited_state = 0;
-      if (!init_state.compare_exchange_strong(uninited_state, 1))
-      {
-        while (init_state.load(std::memory_order_acquire) != 2)
-          ;
-        return;
-      }
-      new (this) WFMPMC();
-      init_state.store(2, std::memory_order_release);
+      return header.attach("WFMPMC", LAYOUT_VERSION, sizeof(T), SIZE, [this]
+                           { new (this) WFMPMC(); });
+    }
+
+    const ShmHeader &shmHeader() const
+    {
+      return header;
     }
 
     ~WFMPMC()
@@ -111,6 +124,7 @@ namespace exchange_core
     {
       auto &blk = blks[idx % SIZE];
       blk.stat.store(~idx, std::memory_order_release);
+      notifier.notify();
     }
 
     // Lounger(All in One) version of write, which is neither wait-free nor zero-copy
@@ -120,11 +134,42 @@ namespace exchange_core
       int64_t idx = getWriteIdx();
       T *data;
       while ((data = getWritable(idx)) == nullptr)
-        ;
+        cpuRelax();
       new (data) T(std::forward<Args>(args)...);
       commitWrite(idx);
     }
 
+    // claims one of the THR_SIZE slots for a producer/consumer that passes the handle to tryVisitPush/tryVisitPop
+    // returns nullptr if all slots are taken
+    Handle *registerHandle()
+    {
+      for (uint32_t i = 0; i < THR_SIZE; i++)
+      {
+        uint32_t tid = tids[i].load(std::memory_order_relaxed);
+        if ((tid == 0 || tid == FREE_TID) && tids[i].compare_exchange_strong(tid, HANDLE_TID, std::memory_order_acquire))
+          return &thr_idxes[i];
+      }
+      return nullptr;
+    }
+
+    // returns the handle's slot for reuse
+    // fails if the handle still holds an index from a tryVisitPush/tryVisitPop that returned false, which has to be
+    // retried until it succeeds, otherwise that index would stall the queue
+    bool unregisterHandle(Handle *handle)
+    {
+      if (handle->write_idx >= 0 || handle->read_idx >= 0)
+        return false;
+      tids[handle - thr_idxes].store(FREE_TID, std::memory_order_release);
+      return true;
+    }
+
+    // same as unregisterHandle() for the slot the calling thread got implicitly through tryPush/tryPop
+    bool unregisterThread()
+    {
+      ThrIdx *thridx = findThrIdx(false);
+      return !thridx || unregisterHandle(thridx);
+    }
+
     // zero-copy and wait-free
     // Visitor's signature: void f(T& val), where val is an *unconstructed* object
     template <typename Visitor>
@@ -133,7 +178,13 @@ namespace exchange_core
       ThrIdx *thridx = getThrIdx();
       if (!thridx)
         return false;
-      int64_t &idx = thridx->write_idx;
+      return tryVisitPush(thridx, v);
+    }
+
+    template <typename Visitor>
+    bool tryVisitPush(Handle *handle, Visitor v)
+    {
+      int64_t &idx = handle->write_idx;
       if (idx < 0)
         idx = getWriteIdx();
       T *data = getWritable(idx);
@@ -154,6 +205,13 @@ namespace exchange_core
           [val = std::forward<decltype(val)>(val)](T &data) { new (&data) T(std::forward<decltype(val)>(val)); });
     }
 
+    template <typename Type>
+    bool tryPush(Handle *handle, Type &&val)
+    {
+      return tryVisitPush(handle,
+          [val = std::forward<decltype(val)>(val)](T &data) { new (&data) T(std::forward<decltype(val)>(val)); });
+    }
+
     int64_t getReadIdx()
     {
       return read_idx.fetch_add(1, std::memory_order_relaxed);
@@ -180,7 +238,7 @@ namespace exchange_core
       int64_t idx = getReadIdx();
       T *data;
       while ((data = getReadable(idx)) == nullptr)
-        ;
+        cpuRelax();
       T ret = std::move(*data);
       commitRead(idx);
       return ret;
@@ -194,7 +252,13 @@ namespace exchange_core
       ThrIdx *thridx = getThrIdx();
       if (!thridx)
         return false;
-      int64_t &idx = thridx->read_idx;
+      return tryVisitPop(thridx, v);
+    }
+
+    template <typename Visitor>
+    bool tryVisitPop(Handle *handle, Visitor v)
+    {
+      int64_t &idx = handle->read_idx;
       if (idx < 0)
       {
         idx = getReadIdx();
@@ -214,34 +278,66 @@ namespace exchange_core
       return tryVisitPop([&](T &&data) { v = std::move(data); });
     }
 
+    bool tryPop(Handle *handle, T &v)
+    {
+      return tryVisitPop(handle, [&](T &&data) { v = std::move(data); });
+    }
+
+    // blocking read, idles with Wait (see WaitStrategy.h) while the queue is empty
+    // Visitor's signature: void f(T&& val)
+    template <class Wait, typename Visitor>
+    void waitVisitPop(Visitor v, Wait w = Wait())
+    {
+      w.wait([&]
+             { return tryVisitPop(v); },
+             notifier);
+    }
+
   private:
-    struct ThrIdx;
+    // tids[] values besides real tids: a slot owned by a Handle, and a released slot that keeps
+    // open addressing chains intact and can be claimed again
+    static constexpr uint32_t HANDLE_TID = UINT32_MAX;
+    static constexpr uint32_t FREE_TID = UINT32_MAX - 1;
+
     ThrIdx *getThrIdx()
+    {
+      return findThrIdx(true);
+    }
+
+    ThrIdx *findThrIdx(bool create)
     {
       if (WFMPMC_tid == 0)
       {
         WFMPMC_tid = static_cast<pid_t>(::syscall(SYS_gettid));
       }
-      uint32_t cur = WFMPMC_tid % THR_SIZE;
-      int cnt = THR_SIZE;
-      while (cnt--)
+      for (;;)
       {
-        uint32_t tid = tids[cur].load(std::memory_order_relaxed);
-        if (tid == WFMPMC_tid)
-          return &thr_idxes[cur];
-        uint32_t null_tid = 0;
-        if (tid == null_tid && tids[cur].compare_exchange_strong(null_tid, WFMPMC_tid, std::memory_order_relaxed))
+        uint32_t cur = WFMPMC_tid % THR_SIZE;
+        int64_t free_slot = -1;
+        int cnt = THR_SIZE;
+        while (cnt--)
         {
-          return &thr_idxes[cur];
+          uint32_t tid = tids[cur].load(std::memory_order_relaxed);
+          if (tid == WFMPMC_tid)
+            return &thr_idxes[cur];
+          if ((tid == FREE_TID || tid == 0) && free_slot < 0)
+            free_slot = cur;
+          if (tid == 0)
+            break;
+          cur = (cur + 1) % THR_SIZE;
         }
-        cur = (cur + 1) % THR_SIZE;
+        // Bad: this thread will return nullptr forever
+        if (!create || free_slot < 0)
+          return nullptr;
+        uint32_t tid = tids[free_slot].load(std::memory_order_relaxed);
+        if ((tid == 0 || tid == FREE_TID) && tids[free_slot].compare_exchange_strong(tid, WFMPMC_tid, std::memory_order_relaxed))
+          return &thr_idxes[free_slot];
+        // lost the slot to another thread, probe again
       }
-      // Bad: this thread will return nullptr forever
-      return nullptr;
     }
 
   private:
-    std::atomic<int> init_state;
+    ShmHeader header;
     alignas(64) std::atomic<int64_t> write_idx;
     alignas(64) std::atomic<int64_t> read_idx;
     struct
@@ -250,6 +346,8 @@ namespace exchange_core
       typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
     } blks[SIZE];
 
+    Notify notifier{};
+
     alignas(64) std::atomic<uint32_t> tids[THR_SIZE];
     struct ThrIdx
     {
@@ -261,6 +359,6 @@ namespace exchange_core
   };
 
   // It's OK to define template static variable in header
-  template <class T, uint32_t SIZE, uint32_t THR_SIZE>
-  thread_local uint32_t WFMPMC<T, SIZE, THR_SIZE>::WFMPMC_tid;
+  template <class T, uint32_t SIZE, uint32_t THR_SIZE, class Notify>
+  thread_local uint32_t WFMPMC<T, SIZE, THR_SIZE, Notify>::WFMPMC_tid;
 }
\ No newline at end of file
@@ -20,8 +20,14 @@ SOFTWARE.
 
 #pragma once
 #include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include "WaitStrategy.h"
+#include "ShmHeader.h"
 
 // THR_SIZE must not be less than the max number of threads using tryPush/tryPop, otherwise they could fail forever
 // It's preferred to set THR_SIZE twice the max number, because THR_SIZE is the size of an open addressing hash table
@@ -29,17 +35,85 @@ SOFTWARE.
 
 namespace exchange_core
 {
-  template <class T, uint32_t SIZE, uint32_t THR_SIZE = 16>
+  // Outcome of a validated read from WFSPMC
+  // OK: the value was copied out intact
+  // NOT_READY: idx has not been published yet
+  // LAPPED: the producer has overwritten idx, see getLag() and getOldestIdx() to resync
+  enum class ReadResult
+  {
+    OK,
+    NOT_READY,
+    LAPPED
+  };
+
+  // Each slot carries a sequence stamp, seqlock-style: -idx while idx is being written and idx once it is published,
+  // so readers can tell a slot that is not written yet from one that was overwritten before or during the read
+  // Notify: NoNotify, or ShmNotifier for readers that wait with FutexWait (see WaitStrategy.h)
+  template <class T, uint32_t SIZE, uint32_t THR_SIZE = 16, class Notify = NoNotify>
   class WFSPMC
   {
   public:
     static_assert(SIZE && !(SIZE & (SIZE - 1)), "SIZE must be a power of 2");
     static_assert(THR_SIZE && !(THR_SIZE & (THR_SIZE - 1)), "THR_SIZE must be a power of 2");
 
+    // bumped whenever the shm layout of this class changes
+    static constexpr uint32_t LAYOUT_VERSION = 1;
+
     // shmInit() should only be called for objects allocated in SHM and are zero-initialized
-    void shmInit()
+    // on reattach it validates the layout and keeps write_idx and the reader cursors
+    bool shmInit()
+    {
+      return header.attach("WFSPMC", LAYOUT_VERSION, sizeof(T), SIZE);
+    }
+
+    const ShmHeader &shmHeader() const
+    {
+      return header;
+    }
+
+    // Durable reader cursors: a reader that opens a cursor by name and commits its progress can resume from
+    // getCursor() after a crash or restart instead of starting over from the producer's current write_idx
+    // returns the cursor id, or -1 if all THR_SIZE cursors are taken or name is longer than 31 chars
+    // a new cursor starts at the next idx to be published
+    int openCursor(const char *name)
+    {
+      if (strlen(name) >= sizeof(cursors[0].name))
+        return -1;
+      for (int i = 0; i < (int)THR_SIZE; i++)
+      {
+        auto &c = cursors[i];
+        if (c.state.load(std::memory_order_acquire) == CURSOR_OPEN && !strcmp(c.name, name))
+          return i;
+      }
+      for (int i = 0; i < (int)THR_SIZE; i++)
+      {
+        auto &c = cursors[i];
+        uint32_t state = CURSOR_FREE;
+        if (!c.state.compare_exchange_strong(state, CURSOR_CLAIMED))
+          continue;
+        strcpy(c.name, name);
+        c.idx.store(write_idx.load(std::memory_order_acquire) + 1, std::memory_order_relaxed);
+        c.state.store(CURSOR_OPEN, std::memory_order_release);
+        return i;
+      }
+      return -1;
+    }
+
+    // next idx the cursor's reader has not consumed yet
+    int64_t getCursor(int id)
     {
-//      new (this) WFSPMC();
+      return cursors[id].idx.load(std::memory_order_acquire);
+    }
+
+    // idx is the next idx to read, i.e. the last consumed idx + 1
+    void commitCursor(int id, int64_t idx)
+    {
+      cursors[id].idx.store(idx, std::memory_order_release);
+    }
+
+    void closeCursor(int id)
+    {
+      cursors[id].state.store(CURSOR_FREE, std::memory_order_release);
     }
 
 
@@ -53,13 +127,34 @@ namespace exchange_core
       return write_idx;
     }
 
+    // number of messages published at or after idx, i.e. how far a reader about to read idx is behind
+    int64_t getLag(int64_t idx)
+    {
+      return write_idx.load(std::memory_order_acquire) - idx + 1;
+    }
+
+    // oldest idx that has not been overwritten yet, where a lapped reader should resume
+    int64_t getOldestIdx()
+    {
+      return std::max<int64_t>(1, write_idx.load(std::memory_order_acquire) - SIZE + 1);
+    }
+
     // if successful, the returned pointer points to an *unconstructed* object that user should construct himself
+    // the slot is marked as being written until commitWrite(idx)
     T *getWritable(int64_t idx)
     {
       auto &blk = blks[idx % SIZE];
+      blk.seq.store(-idx, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
       return reinterpret_cast<T *>(&blk.data);
     }
 
+    void commitWrite(int64_t idx)
+    {
+      blks[idx % SIZE].seq.store(idx, std::memory_order_release);
+      write_idx.store(idx, std::memory_order_release);
+      notifier.notify();
+    }
 
     // Lounger(All in One) version of write, which is neither wait-free nor zero-copy
     template <typename... Args>
@@ -68,7 +163,7 @@ namespace exchange_core
       int64_t idx = write_idx + 1;
       T *data = getWritable(idx);
       new (data) T(std::forward<Args>(args)...);
-      write_idx = idx;
+      commitWrite(idx);
     }
 
     // zero-copy and wait-free
@@ -81,7 +176,7 @@ namespace exchange_core
       if (!data)
         return false;
       v(*data);
-      write_idx = idx;
+      commitWrite(idx);
       return true;
     }
 
@@ -110,25 +205,73 @@ namespace exchange_core
 
     // zero-copy and wait-free
     // Visitor's signature: void f(T&& val)
+    // NOT_READY or LAPPED without calling v if idx is not published yet or already overwritten, and LAPPED after
+    // calling v if the producer lapped the reader while v was running, in which case v has seen a torn object
+    // and whatever it did with it must be discarded
     template <typename Visitor>
-    bool tryVisitPop(Visitor v, int64_t idx)
+    ReadResult tryVisitPop(Visitor v, int64_t idx)
     {
-      T *data = getReadable(idx);
-      if (!data)
-        return false;
-      v(std::move(*data));
-      return true;
+      auto &blk = blks[idx % SIZE];
+      int64_t seq = blk.seq.load(std::memory_order_acquire);
+      if (seq != idx)
+        return std::abs(seq) > idx ? ReadResult::LAPPED : ReadResult::NOT_READY;
+      v(std::move(*getReadable(idx)));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return blk.seq.load(std::memory_order_relaxed) == idx ? ReadResult::OK : ReadResult::LAPPED;
     }
 
+    // not zero-copy, but wait-free; out is only assigned if the copy is intact
+    ReadResult tryRead(T &out, int64_t idx)
+    {
+      static_assert(std::is_trivially_copyable<T>::value, "tryRead requires a trivially copyable T");
+      auto &blk = blks[idx % SIZE];
+      int64_t seq = blk.seq.load(std::memory_order_acquire);
+      if (seq != idx)
+        return std::abs(seq) > idx ? ReadResult::LAPPED : ReadResult::NOT_READY;
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type copy = blk.data;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (blk.seq.load(std::memory_order_relaxed) != idx)
+        return ReadResult::LAPPED;
+      out = reinterpret_cast<T &>(copy);
+      return ReadResult::OK;
+    }
+
+    // blocking version of tryRead, idles with Wait (see WaitStrategy.h) until idx is published or lapped
+    template <class Wait>
+    ReadResult waitRead(T &out, int64_t idx, Wait w = Wait())
+    {
+      ReadResult ret;
+      w.wait([&]
+             { return (ret = tryRead(out, idx)) != ReadResult::NOT_READY; },
+             notifier);
+      return ret;
+    }
 
- 
   private:
+    enum : uint32_t
+    {
+      CURSOR_FREE = 0,
+      CURSOR_CLAIMED,
+      CURSOR_OPEN
+    };
+
+    ShmHeader header;
     alignas(64) std::atomic<int64_t> write_idx;
     struct
     {
+      std::atomic<int64_t> seq;
       typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
     } blks[SIZE];
 
+    Notify notifier;
+
+    // each cursor on its own cache line, as every reader commits its own
+    struct alignas(64)
+    {
+      std::atomic<uint32_t> state;
+      char name[32];
+      std::atomic<int64_t> idx;
+    } cursors[THR_SIZE];
   };
 
 }
\ No newline at end of file
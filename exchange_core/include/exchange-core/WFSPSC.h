@@ -20,8 +20,12 @@ SOFTWARE.
 
 #pragma once
 #include <atomic>
+#include <algorithm>
+#include <type_traits>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include "WaitStrategy.h"
+#include "ShmHeader.h"
 
 // THR_SIZE must not be less than the max number of threads using tryPush/tryPop, otherwise they could fail forever
 // It's preferred to set THR_SIZE twice the max number, because THR_SIZE is the size of an open addressing hash table
@@ -29,16 +33,47 @@ SOFTWARE.
 
 namespace exchange_core
 {
-  template <class T, uint32_t SIZE, uint32_t THR_SIZE = 16>
+  // What the producer does when the ring is full
+  // OVERWRITE: unbounded, unread slots are silently overwritten (the original behavior)
+  // FAIL: push returns false, emplace waits
+  // SPIN: push waits for the consumer to free a slot
+  // DROP_OLDEST: the oldest unread slots are discarded and counted in getDroppedCount(),
+  //              T must be trivially copyable because pop validates a private copy of the slot
+  enum class OverflowPolicy
+  {
+    OVERWRITE,
+    FAIL,
+    SPIN,
+    DROP_OLDEST
+  };
+
+  // Notify: NoNotify, or ShmNotifier for consumers that wait with FutexWait (see WaitStrategy.h)
+  template <class T, uint32_t SIZE, uint32_t THR_SIZE = 16, OverflowPolicy POLICY = OverflowPolicy::OVERWRITE,
+            class Notify = NoNotify>
   class WFSPSC
   {
   public:
     static_assert(SIZE && !(SIZE & (SIZE - 1)), "SIZE must be a power of 2");
     static_assert(THR_SIZE && !(THR_SIZE & (THR_SIZE - 1)), "THR_SIZE must be a power of 2");
+    static_assert(POLICY != OverflowPolicy::DROP_OLDEST || std::is_trivially_copyable<T>::value,
+                  "DROP_OLDEST requires a trivially copyable T");
+
+    static constexpr bool BOUNDED = POLICY != OverflowPolicy::OVERWRITE;
+
+    // bumped whenever the shm layout of this class changes
+    static constexpr uint32_t LAYOUT_VERSION = 1;
 
     // shmInit() should only be called for objects allocated in SHM and are zero-initialized
-    void shmInit()
+    // on reattach, e.g. after a restart, it validates the layout and keeps the indexes: a restarted consumer
+    // resumes after the last slot it committed
+    bool shmInit()
     {
+      return header.attach("WFSPSC", LAYOUT_VERSION, sizeof(T), SIZE);
+    }
+
+    const ShmHeader &shmHeader() const
+    {
+      return header;
     }
 
     int64_t size()
@@ -52,10 +87,14 @@ namespace exchange_core
       return size() <= 0;
     }
 
+    // starts over with an empty queue, not to be called by a process reattaching to a live queue
     void reset()
     {
       write_idx = 0;
       read_idx = 0;
+      cached_read_idx = 0;
+      cached_write_idx = 0;
+      dropped = 0;
     }
 
     int64_t getCurrentWriteIdx()
@@ -68,6 +107,12 @@ namespace exchange_core
       return read_idx;
     }
 
+    // number of unread slots discarded by the producer under DROP_OLDEST
+    int64_t getDroppedCount()
+    {
+      return dropped.load(std::memory_order_relaxed);
+    }
+
     T *getWritable(int64_t idx)
     {
       auto &blk = blks[idx % SIZE];
@@ -78,10 +123,13 @@ namespace exchange_core
     template <typename... Args>
     void emplace(Args &&...args)
     {
-      int64_t idx = write_idx + 1;
+      int64_t idx = write_idx.load(std::memory_order_relaxed) + 1;
+      while (!reserve(idx))
+        cpuRelax();
       T *data = getWritable(idx);
       new (data) T(std::forward<Args>(args)...);
-      write_idx = idx;
+      write_idx.store(idx, std::memory_order_release);
+      notifier.notify();
     }
 
     // zero-copy and wait-free
@@ -89,13 +137,49 @@ namespace exchange_core
     template <typename Visitor>
     bool tryVisitPush(Visitor v)
     {
-      int64_t idx = write_idx + 1;
+      int64_t idx = write_idx.load(std::memory_order_relaxed) + 1;
+      if (!reserve(idx))
+        return false;
       T *data = getWritable(idx);
       v(*data);
-      write_idx = idx;
+      write_idx.store(idx, std::memory_order_release);
+      notifier.notify();
       return true;
     }
 
+    // zero-copy batch write, write_idx is published once for the whole batch
+    // Visitor's signature: void f(T* vals, uint32_t cnt), where vals are *unconstructed* objects
+    // vals are contiguous in the ring, so f is called twice when the batch wraps around the end of blks
+    // returns the number of slots written, which is at most SIZE and, under FAIL, at most the free slots
+    template <typename Visitor>
+    uint32_t tryVisitPushBatch(Visitor v, uint32_t n)
+    {
+      if (n > SIZE)
+        n = SIZE;
+      int64_t first = write_idx.load(std::memory_order_relaxed) + 1;
+      if constexpr (POLICY == OverflowPolicy::FAIL)
+      {
+        int64_t room = cached_read_idx + SIZE - first + 1;
+        if (room < n)
+        {
+          cached_read_idx = read_idx.load(std::memory_order_acquire);
+          room = cached_read_idx + SIZE - first + 1;
+          if (room < n)
+            n = room;
+        }
+      }
+      else
+      {
+        reserve(first + n - 1);
+      }
+      if (n == 0)
+        return 0;
+      visitRange(v, first, n);
+      write_idx.store(first + n - 1, std::memory_order_release);
+      notifier.notify();
+      return n;
+    }
+
     template <typename Type>
     bool tryPush(Type &&val)
     {
@@ -113,28 +197,181 @@ namespace exchange_core
     // Lounger(All in One) version of read, which is neither wait-free nor zero-copy
     T pop()
     {
-      int64_t idx = read_idx + 1;
-      T *data = getReadable(idx);
-      T ret = std::move(*data);
-      read_idx = idx;
-      return ret;
+      if constexpr (POLICY == OverflowPolicy::DROP_OLDEST)
+      {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type ret;
+        while (!tryVisitPop([&](T &&val) { new (&ret) T(std::move(val)); }))
+          cpuRelax();
+        return reinterpret_cast<T &>(ret);
+      }
+      else
+      {
+        int64_t idx = read_idx.load(std::memory_order_relaxed) + 1;
+        if constexpr (BOUNDED)
+        {
+          while (!readable(idx))
+            cpuRelax();
+        }
+        T *data = getReadable(idx);
+        T ret = std::move(*data);
+        read_idx.store(idx, std::memory_order_release);
+        return ret;
+      }
     }
 
-    // zero-copy and wait-free
+    // zero-copy and wait-free, except under DROP_OLDEST where v gets a validated copy of the slot
     // Visitor's signature: void f(T&& val)
     template <typename Visitor>
     bool tryVisitPop(Visitor v)
     {
-      int64_t idx = read_idx + 1;
-      T *data = getReadable(idx);
-      v(std::move(*data));
-      read_idx = idx;
-      return true;
+      int64_t idx = read_idx.load(std::memory_order_relaxed) + 1;
+      if constexpr (POLICY == OverflowPolicy::DROP_OLDEST)
+      {
+        // the producer may advance read_idx under us, so the slot is copied first and
+        // only handed out if we win the race to commit it
+        int64_t last = idx - 1;
+        while (readable(idx))
+        {
+          typename std::aligned_storage<sizeof(T), alignof(T)>::type copy = blks[idx % SIZE].data;
+          if (read_idx.compare_exchange_strong(last, idx, std::memory_order_acq_rel))
+          {
+            v(std::move(reinterpret_cast<T &>(copy)));
+            return true;
+          }
+          idx = last + 1;
+        }
+        return false;
+      }
+      else
+      {
+        if constexpr (BOUNDED)
+        {
+          if (!readable(idx))
+            return false;
+        }
+        T *data = getReadable(idx);
+        v(std::move(*data));
+        read_idx.store(idx, std::memory_order_release);
+        return true;
+      }
+    }
+
+    // zero-copy batch read of up to n readable slots, read_idx is published once for the whole batch
+    // Visitor's signature: void f(T* vals, uint32_t cnt), vals can be moved from
+    // vals are contiguous in the ring, so f is called twice when the batch wraps around the end of blks
+    // under DROP_OLDEST every slot is validated on its own and f is called once per slot
+    // returns the number of slots read, 0 if the queue is empty
+    template <typename Visitor>
+    uint32_t tryVisitPopBatch(Visitor v, uint32_t n)
+    {
+      if constexpr (POLICY == OverflowPolicy::DROP_OLDEST)
+      {
+        uint32_t cnt = 0;
+        while (cnt < n && tryVisitPop([&](T &&val) { v(&val, 1); }))
+          cnt++;
+        return cnt;
+      }
+      else
+      {
+        int64_t first = read_idx.load(std::memory_order_relaxed) + 1;
+        if (!readable(first))
+          return 0;
+        int64_t avail = cached_write_idx - first + 1;
+        if (n > avail)
+          n = avail;
+        visitRange(v, first, n);
+        read_idx.store(first + n - 1, std::memory_order_release);
+        return n;
+      }
+    }
+
+    // blocking read, idles with Wait (see WaitStrategy.h) while the queue is empty
+    // Visitor's signature: void f(T&& val)
+    template <class Wait, typename Visitor>
+    void waitVisitPop(Visitor v, Wait w = Wait())
+    {
+      w.wait([&]
+             {
+               if constexpr (!BOUNDED)
+               {
+                 if (!readable(read_idx.load(std::memory_order_relaxed) + 1))
+                   return false;
+               }
+               return tryVisitPop(v);
+             },
+             notifier);
     }
 
   private:
+    // producer side: makes room for writing up to idx, re-reading read_idx only when the cached copy says full
+    bool reserve(int64_t idx)
+    {
+      if constexpr (!BOUNDED)
+      {
+        return true;
+      }
+      else
+      {
+        if (idx - cached_read_idx <= SIZE)
+          return true;
+        cached_read_idx = read_idx.load(std::memory_order_acquire);
+        if constexpr (POLICY == OverflowPolicy::SPIN)
+        {
+          while (idx - cached_read_idx > SIZE)
+          {
+            cpuRelax();
+            cached_read_idx = read_idx.load(std::memory_order_acquire);
+          }
+        }
+        else if constexpr (POLICY == OverflowPolicy::DROP_OLDEST)
+        {
+          int64_t last = cached_read_idx;
+          while (idx - last > SIZE)
+          {
+            if (read_idx.compare_exchange_weak(last, idx - SIZE, std::memory_order_acq_rel))
+            {
+              dropped.store(dropped.load(std::memory_order_relaxed) + idx - SIZE - last, std::memory_order_relaxed);
+              last = idx - SIZE;
+            }
+          }
+          cached_read_idx = last;
+        }
+        return idx - cached_read_idx <= SIZE;
+      }
+    }
+
+    // consumer side: true if idx has been written, re-reading write_idx only when the cached copy says empty
+    bool readable(int64_t idx)
+    {
+      if (idx <= cached_write_idx)
+        return true;
+      cached_write_idx = write_idx.load(std::memory_order_acquire);
+      return idx <= cached_write_idx;
+    }
+
+    template <typename Visitor>
+    void visitRange(Visitor &v, int64_t first, uint32_t n)
+    {
+      uint32_t pos = first % SIZE;
+      uint32_t cnt = std::min(n, SIZE - pos);
+      v(reinterpret_cast<T *>(&blks[pos].data), cnt);
+      if (cnt < n)
+        v(reinterpret_cast<T *>(&blks[0].data), n - cnt);
+    }
+
+  private:
+    ShmHeader header;
+
+    // producer's cache line
     alignas(64) std::atomic<int64_t> write_idx;
+    int64_t cached_read_idx;
+    std::atomic<int64_t> dropped;
+
+    // consumer's cache line
     alignas(64) std::atomic<int64_t> read_idx;
+    int64_t cached_write_idx;
+
+    Notify notifier;
 
     struct
     {
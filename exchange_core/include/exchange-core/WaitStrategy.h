@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <type_traits>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace exchange_core
+{
+  inline void cpuRelax()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+  }
+
+  // Notify policies of the shm queues, the producer calls notify() after every publish
+  // Producer and consumers of a queue must agree on the policy, only ShmNotifier lets consumers use FutexWait
+
+  // the default, costs the producer nothing; consumers spin, pause or yield
+  struct NoNotify
+  {
+    // keeps the queue's shm layout the same as with ShmNotifier
+    alignas(64) uint32_t reserved[2]{};
+
+    void notify()
+    {
+    }
+  };
+
+  // Lives in the shm queue so producer and consumers in different processes can hand off sleeps and wakeups
+  // notify() is a full fence and a load of the sleeper count unless someone sleeps
+  struct ShmNotifier
+  {
+    // zero like the rest of a fresh shm segment when the queue is constructed instead of mapped
+    alignas(64) std::atomic<uint32_t> seq{0};
+    std::atomic<uint32_t> sleepers{0};
+
+    void notify()
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (sleepers.load(std::memory_order_relaxed) == 0)
+        return;
+      seq.fetch_add(1, std::memory_order_release);
+      ::syscall(SYS_futex, &seq, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    // registers as a sleeper, then sleeps until notify() unless ready() turns true first
+    // returns ready()'s result, false after a wakeup
+    template <typename Pred>
+    bool sleep(Pred &ready)
+    {
+      uint32_t cur = seq.load(std::memory_order_acquire);
+      sleepers.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      bool ret = ready();
+      if (!ret)
+        ::syscall(SYS_futex, &seq, FUTEX_WAIT, cur, nullptr, nullptr, 0);
+      sleepers.fetch_sub(1, std::memory_order_relaxed);
+      return ret;
+    }
+  };
+
+  static_assert(sizeof(NoNotify) == sizeof(ShmNotifier), "notify policies must not change the queue layout");
+
+  // Wait strategies for consumers, wait() returns once ready() is true
+  // ready() is expected to do the actual read, e.g. [&] { return q->tryVisitPop(v); }
+
+  // lowest latency, burns a full core
+  struct BusySpinWait
+  {
+    template <typename Pred, typename Notify>
+    void wait(Pred ready, Notify &)
+    {
+      while (!ready())
+        ;
+    }
+  };
+
+  // still burns a core, but is friendly to the sibling hyper-thread and saves power
+  struct PauseWait
+  {
+    template <typename Pred, typename Notify>
+    void wait(Pred ready, Notify &)
+    {
+      while (!ready())
+        cpuRelax();
+    }
+  };
+
+  // for consumers sharing cores with others
+  struct YieldWait
+  {
+    template <typename Pred, typename Notify>
+    void wait(Pred ready, Notify &)
+    {
+      while (!ready())
+        sched_yield();
+    }
+  };
+
+  // spins SPINS times, then sleeps on the queue's futex until the producer publishes
+  // only for queues whose Notify policy is ShmNotifier
+  template <uint32_t SPINS = 1000>
+  struct FutexWait
+  {
+    template <typename Pred, typename Notify>
+    void wait(Pred ready, Notify &notifier)
+    {
+      static_assert(std::is_same<Notify, ShmNotifier>::value, "FutexWait needs a queue with ShmNotifier");
+      for (uint32_t i = 0; i < SPINS; i++)
+      {
+        if (ready())
+          return;
+        cpuRelax();
+      }
+      while (!notifier.sleep(ready))
+        ;
+    }
+  };
+}
@@ -6,7 +6,12 @@
 #include <fstream>
 #include <chrono>
 #include <sstream>
+#include <cmath>
+#include <charconv>
+#include <string_view>
 
+#include "Clock.h"
+#include "FixedPoint.h"
 #include "shm.h"
 
 namespace exchange_core
@@ -22,36 +27,115 @@ namespace exchange_core
 	struct Instrument
 	{
 		std::string symbol;
-		InstrumentType type;
-		int instrument_id;
+		InstrumentType type = InstrumentType::CRYPTO;
+		int instrument_id = -1;
+		// units per 1.0 of Price and Qty
+		int64_t price_scale = 1;
+		int64_t qty_scale = 1;
+		// minimum price increment in Price units, 0 if unknown
+		int64_t tick_size = 0;
+
+		Price toPrice(double price) const { return Price::fromDouble(price, price_scale); }
+		Qty toQty(double qty) const { return Qty::fromDouble(qty, qty_scale); }
+		double toDouble(Price price) const { return price.toDouble(price_scale); }
+		double toDouble(Qty qty) const { return qty.toDouble(qty_scale); }
 	};
 
 	struct FeedTrade
 	{
 		int instrument_id;
 		long timestamp;
-		double price;
-		double quantity;
+		Price price;
+		Qty quantity;
 		Side side;
 		ExchangeEnum exchange;
 	};
 
 	struct FeedPriceLevel
 	{
-		double quantity;
-		double price;
+		Qty quantity;
+		Price price;
 		int number_of_order;
 	};
 
+	// vector-like container with inline storage for up to N elements, never allocates
+	// push_back beyond capacity() is dropped and returns false
+	template <class T, size_t N>
+	class FixedVector
+	{
+	public:
+		using value_type = T;
+		using iterator = T *;
+		using const_iterator = const T *;
+
+		bool push_back(const T &val)
+		{
+			if (count == N)
+				return false;
+			items[count++] = val;
+			return true;
+		}
+
+		void clear() { count = 0; }
+		size_t size() const { return count; }
+		bool empty() const { return count == 0; }
+		bool full() const { return count == N; }
+		static constexpr size_t capacity() { return N; }
+
+		T &operator[](size_t i) { return items[i]; }
+		const T &operator[](size_t i) const { return items[i]; }
+		T &front() { return items[0]; }
+		const T &front() const { return items[0]; }
+		T &back() { return items[count - 1]; }
+		const T &back() const { return items[count - 1]; }
+
+		iterator begin() { return items; }
+		iterator end() { return items + count; }
+		const_iterator begin() const { return items; }
+		const_iterator end() const { return items + count; }
+
+	private:
+		size_t count = 0;
+		T items[N];
+	};
+
+	// max number of levels per side an OrderBook carries
+	constexpr size_t ORDER_BOOK_DEPTH = 20;
+
+	// Delivered to MarketDataEventListener without allocating, services keep one and refill it on every update
 	struct OrderBook
 	{
 		ExchangeEnum exchange;
 		int instrumentId;
 		long timestamp;
-		std::vector<FeedPriceLevel> asks;
-		std::vector<FeedPriceLevel> bids;
+		FixedVector<FeedPriceLevel, ORDER_BOOK_DEPTH> asks;
+		FixedVector<FeedPriceLevel, ORDER_BOOK_DEPTH> bids;
 	};
 
+	// Refills book with the best levels of a full depth book such as PriceLadder, anything with
+	// visit(side, depth, f) handing out levels with raw price and quantity, without allocating
+	template <class Ladder>
+	void fillOrderBook(OrderBook &book, ExchangeEnum exchange, int instrumentId, long timestamp, const Ladder &ladder)
+	{
+		book.exchange = exchange;
+		book.instrumentId = instrumentId;
+		book.timestamp = timestamp;
+		book.bids.clear();
+		book.asks.clear();
+		FeedPriceLevel level;
+		level.number_of_order = 1;
+		ladder.visit(Side::BUY, book.bids.capacity(), [&](const auto &l)
+					 {
+						 level.price = Price(l.price);
+						 level.quantity = Qty(l.quantity);
+						 book.bids.push_back(level); });
+		ladder.visit(Side::SELL, book.asks.capacity(), [&](const auto &l)
+					 {
+						 level.price = Price(l.price);
+						 level.quantity = Qty(l.quantity);
+						 book.asks.push_back(level); });
+	}
+
 	class MarketDataEventListener
 	{
 	public:
@@ -126,14 +210,14 @@ namespace exchange_core
 	{
 		std::string clientOrderId;
 		std::string exchangeOrderId;
-		double price;
-		double quantity;
+		Price price;
+		Qty quantity;
 		Side side;
 		std::string symbol;
 		int instrumentId;
 		OrderStatus orderStatus;
 		OrderType orderType;
-		double cumulateQuantity;
+		Qty cumulateQuantity;
 		double averagePrice;
 		long createTime;
 		long ackTime;
@@ -157,14 +241,14 @@ namespace exchange_core
 		std::string symbol;
 		OrderType orderType;
 		Side side;
-		double price;
-		double quantity;
+		Price price;
+		Qty quantity;
 		OrderStatus orderStatus;
-		double cumQuantity;
+		Qty cumQuantity;
 		double cumValue;
 		double averagePrice;
-		double lastExecPrice;
-		double lastExecQuantity;
+		Price lastExecPrice;
+		Qty lastExecQuantity;
 		long createTime;
 		long transactionTime;
 		long eventTime;
@@ -250,46 +334,263 @@ namespace exchange_core
 		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 	}
 
+	// Instruments in an array indexed by instrument_id, plus an open addressing table of symbol -> instrument_id
+	// that is probed with a string_view, so lookups never allocate and never insert
+	// load() keeps a binary cache next to the CSV (<file>.bin) and maps it instead of parsing the CSV again as long as
+	// the CSV hasn't changed
 	class SecurityMaster
 	{
 	public:
+		static constexpr int MAX_INSTRUMENT_ID = 1 << 20;
+
+		// CSV lines: instrument_id,symbol[,price_scale[,qty_scale[,tick_size]]]
+		// a missing scale defaults to 1, with a warning, as prices and quantities then round to whole units
 		bool load(const std::string &file)
 		{
-			std::fstream fin;
-			fin.open(file, std::ios::in);
-			std::string line;
-
-			while (std::getline(fin, line))
+			struct stat st;
+			if (stat(file.c_str(), &st))
+			{
+				spdlog::error("cannot open security master {}", file);
+				return false;
+			}
+			if (loadCache(file + ".bin", st))
 			{
-				auto items = split(line, ',');
-				Instrument instr;
-				instr.symbol = items[1];
-				instr.instrument_id = std::stoi(items[0]);
-				mInstrumentMap[items[1]] = instr;
-				//				spdlog::info(mInstrumentMap[items[1]].symbol);
+				defaultScales();
+				return true;
 			}
 
+			std::ifstream fin(file, std::ios::binary);
+			std::string text((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+			mInstruments.clear();
+			std::string_view rest(text);
+			while (!rest.empty())
+			{
+				size_t eol = rest.find('\n');
+				std::string_view line = rest.substr(0, eol);
+				rest = eol == std::string_view::npos ? std::string_view() : rest.substr(eol + 1);
+				if (!line.empty() && line.back() == '\r')
+					line.remove_suffix(1);
+				if (!line.empty() && !parse(line))
+					spdlog::error("invalid security master line {}", line);
+			}
+			buildIndex();
+			saveCache(file + ".bin", st);
+			defaultScales();
 			return true;
 		}
 
-		Instrument getInstrument(const std::string &symbol)
+		// nullptr if the symbol is unknown
+		const Instrument *find(std::string_view symbol) const
+		{
+			if (mIndex.empty())
+				return nullptr;
+			size_t mask = mIndex.size() - 1;
+			for (size_t i = hash(symbol) & mask;; i = (i + 1) & mask)
+			{
+				uint32_t slot = mIndex[i];
+				if (!slot)
+					return nullptr;
+				if (mInstruments[slot - 1].symbol == symbol)
+					return &mInstruments[slot - 1];
+			}
+		}
+
+		// nullptr if there is no instrument with that id
+		const Instrument *get(int instrumentId) const
+		{
+			if (instrumentId < 0 || instrumentId >= (int)mInstruments.size() || mInstruments[instrumentId].instrument_id != instrumentId)
+				return nullptr;
+			return &mInstruments[instrumentId];
+		}
+
+		// a default Instrument, with instrument_id -1, if the symbol is unknown
+		Instrument getInstrument(std::string_view symbol) const
+		{
+			const Instrument *instr = find(symbol);
+			return instr ? *instr : Instrument();
+		}
+
+		size_t size() const
 		{
-			return mInstrumentMap[symbol];
+			return mCount;
 		}
 
 	private:
-		std::vector<std::string> split(const std::string &s, char delim)
+		static constexpr uint32_t CACHE_MAGIC = 0x4d534543; // "CESM"
+		static constexpr uint32_t CACHE_VERSION = 3;
+
+		struct CacheHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			int64_t csv_size;
+			int64_t csv_mtime;
+			uint32_t instrument_cnt;
+			uint32_t index_size;
+		};
+
+		// scales are 0 where the CSV has none, so a load from the cache warns about them too
+		struct CacheRecord
+		{
+			int32_t instrument_id;
+			int32_t type;
+			int64_t price_scale;
+			int64_t qty_scale;
+			int64_t tick_size;
+			char symbol[32];
+		};
+
+		static size_t hash(std::string_view symbol)
+		{
+			// FNV-1a
+			uint64_t h = 14695981039346656037ull;
+			for (unsigned char c : symbol)
+				h = (h ^ c) * 1099511628211ull;
+			return h;
+		}
+
+		template <class T>
+		static bool toNumber(std::string_view field, T &out)
+		{
+			auto res = std::from_chars(field.data(), field.data() + field.size(), out);
+			return res.ec == std::errc() && res.ptr == field.data() + field.size();
+		}
+
+		bool parse(std::string_view line)
+		{
+			std::string_view fields[5];
+			size_t cnt = 0;
+			while (cnt < 5)
+			{
+				size_t comma = line.find(',');
+				fields[cnt++] = line.substr(0, comma);
+				if (comma == std::string_view::npos)
+					break;
+				line.remove_prefix(comma + 1);
+			}
+			// scales stay 0 until defaultScales() if the line has none
+			Instrument instr;
+			instr.price_scale = instr.qty_scale = 0;
+			if (cnt < 2 || !toNumber(fields[0], instr.instrument_id) || instr.instrument_id < 0 || instr.instrument_id >= MAX_INSTRUMENT_ID)
+				return false;
+			if ((cnt > 2 && (!toNumber(fields[2], instr.price_scale) || instr.price_scale <= 0)) ||
+				(cnt > 3 && (!toNumber(fields[3], instr.qty_scale) || instr.qty_scale <= 0)) ||
+				(cnt > 4 && (!toNumber(fields[4], instr.tick_size) || instr.tick_size < 0)))
+				return false;
+			instr.symbol = fields[1];
+			if (instr.instrument_id >= (int)mInstruments.size())
+				mInstruments.resize(instr.instrument_id + 1);
+			mInstruments[instr.instrument_id] = std::move(instr);
+			return true;
+		}
+
+		void defaultScales()
+		{
+			for (auto &instr : mInstruments)
+			{
+				if (instr.instrument_id < 0 || (instr.price_scale && instr.qty_scale))
+					continue;
+				spdlog::warn("{} has no {} scale in the security master, it rounds to whole units", instr.symbol,
+							 !instr.price_scale && !instr.qty_scale ? "price or qty" : !instr.price_scale ? "price" : "qty");
+				if (!instr.price_scale)
+					instr.price_scale = 1;
+				if (!instr.qty_scale)
+					instr.qty_scale = 1;
+			}
+		}
+
+		void buildIndex()
+		{
+			mCount = 0;
+			for (auto &instr : mInstruments)
+				mCount += instr.instrument_id >= 0;
+			size_t size = 16;
+			while (size < mCount * 2)
+				size *= 2;
+			mIndex.assign(size, 0);
+			for (auto &instr : mInstruments)
+			{
+				if (instr.instrument_id < 0)
+					continue;
+				size_t i = hash(instr.symbol) & (size - 1);
+				while (mIndex[i] && mInstruments[mIndex[i] - 1].symbol != instr.symbol)
+					i = (i + 1) & (size - 1);
+				// a later line for the same symbol wins, as with the map this replaced
+				mIndex[i] = instr.instrument_id + 1;
+			}
+		}
+
+		bool loadCache(const std::string &path, const struct stat &csv)
 		{
-			std::stringstream ss(s);
-			std::string item;
-			std::vector<std::string> elems;
-			while (std::getline(ss, item, delim))
+			int fd = open(path.c_str(), O_RDONLY);
+			if (fd == -1)
+				return false;
+			struct stat st;
+			void *p = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CacheHeader) ? mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+			close(fd);
+			if (p == MAP_FAILED)
+				return false;
+			auto *header = (const CacheHeader *)p;
+			auto *records = (const CacheRecord *)(header + 1);
+			auto *index = (const uint32_t *)(records + header->instrument_cnt);
+			bool valid = header->magic == CACHE_MAGIC && header->version == CACHE_VERSION && header->csv_size == csv.st_size &&
+						 header->csv_mtime == csv.st_mtim.tv_sec * 1000000000 + csv.st_mtim.tv_nsec &&
+						 (size_t)st.st_size == sizeof(CacheHeader) + header->instrument_cnt * sizeof(CacheRecord) + header->index_size * sizeof(uint32_t);
+			if (valid)
 			{
-				elems.push_back(std::move(item)); // if C++11 (based on comment from @mchiasson)
+				mInstruments.assign(header->instrument_cnt, Instrument());
+				mCount = 0;
+				for (uint32_t i = 0; i < header->instrument_cnt; i++)
+				{
+					auto &rec = records[i];
+					if (rec.instrument_id < 0)
+						continue;
+					auto &instr = mInstruments[i];
+					instr.instrument_id = rec.instrument_id;
+					instr.type = (InstrumentType)rec.type;
+					instr.price_scale = rec.price_scale;
+					instr.qty_scale = rec.qty_scale;
+					instr.tick_size = rec.tick_size;
+					instr.symbol = rec.symbol;
+					mCount++;
+				}
+				mIndex.assign(index, index + header->index_size);
 			}
-			return elems;
+			munmap(p, st.st_size);
+			return valid;
 		}
-		std::unordered_map<std::string, Instrument> mInstrumentMap;
+
+		void saveCache(const std::string &path, const struct stat &csv)
+		{
+			CacheHeader header{CACHE_MAGIC, CACHE_VERSION, csv.st_size, csv.st_mtim.tv_sec * 1000000000 + csv.st_mtim.tv_nsec,
+							   (uint32_t)mInstruments.size(), (uint32_t)mIndex.size()};
+			std::vector<CacheRecord> records(mInstruments.size());
+			for (size_t i = 0; i < mInstruments.size(); i++)
+			{
+				auto &instr = mInstruments[i];
+				if (instr.symbol.size() >= sizeof(records[i].symbol))
+					return;
+				records[i] = CacheRecord{instr.instrument_id, (int32_t)instr.type, instr.price_scale, instr.qty_scale, instr.tick_size, {}};
+				memcpy(records[i].symbol, instr.symbol.data(), instr.symbol.size());
+			}
+			// written aside and renamed, so a concurrent load never maps half a cache
+			std::string tmp = path + "." + std::to_string(getpid());
+			std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+			out.write((const char *)&header, sizeof(header));
+			out.write((const char *)records.data(), records.size() * sizeof(CacheRecord));
+			out.write((const char *)mIndex.data(), mIndex.size() * sizeof(uint32_t));
+			out.close();
+			if (!out || rename(tmp.c_str(), path.c_str()))
+			{
+				spdlog::warn("cannot write security master cache {}", path);
+				unlink(tmp.c_str());
+			}
+		}
+
+		std::vector<Instrument> mInstruments;
+		// instrument_id + 1, 0 for an empty slot
+		std::vector<uint32_t> mIndex;
+		size_t mCount = 0;
 	};
 
 	exchange_core::ExchangeEnum toExchangeEnum(const std::string &name)
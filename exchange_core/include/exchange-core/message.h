@@ -1,5 +1,7 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include "FixedPoint.h"
 
 namespace exchange_core
 {
@@ -88,6 +90,16 @@ namespace exchange_core
     HEARTBEAT, 
     EECHO,
     JSON,
+
+    // v2 wire layout, see MessageHeaderV2
+    TRADE_V2 = 64,
+    BBO_V2,
+    NEW_ORDER_V2,
+    BOOK_DELTA,
+    BOOK_SNAPSHOT,
+
+    // one past the largest type, SPSCVarQueue reserves 0xFFFF for its padding records
+    MESSAGE_TYPE_END,
   };
 
   struct TradeMessage : MessageHeader
@@ -259,7 +271,7 @@ namespace exchange_core
     BalanceReportMessage()
     {
       message_type = MessageType::BALANCE_REPORT;
-      message_size = sizeof(ExecutionReportMessage);
+      message_size = sizeof(BalanceReportMessage);
     }
 
     char currency[8]{0};
@@ -291,4 +303,193 @@ namespace exchange_core
 
     char json_str[MAX_MESSAGE_SIZE - sizeof(MessageHeader) - 128];
   };
-}
\ No newline at end of file
+
+  // v2 wire layout
+  // Prices and quantities are Price and Qty, int64 fixed point scaled per instrument (e.g. 10000 for Phemex's
+  // priceEp) and converted with the Instrument's scales like everywhere else, enums are
+  // stored in a byte and every field sits at an explicit, static_assert'ed offset. Hot messages fit in one cache line
+
+  // the v2 structs derive from their header like the v1 ones, which makes them non-standard-layout; GCC and clang
+  // lay them out as if they were not, offsetof is only used to pin that layout down
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+
+  // an enum stored in a single byte
+  template <typename E>
+  struct PackedEnum
+  {
+    uint8_t value;
+
+    PackedEnum() = default;
+    constexpr PackedEnum(E e) : value(static_cast<uint8_t>(e)) {}
+    constexpr operator E() const { return static_cast<E>(value); }
+  };
+
+  // message_type, message_size and seq sit where they are in MessageHeader, so queues, the bridge and the
+  // dispatching code can handle both layouts
+  struct MessageHeaderV2
+  {
+    uint16_t message_type;
+    uint16_t message_size;
+    uint32_t instrument_id;
+    PackedEnum<ExchangeEnum> exchange;
+    uint8_t version;
+    uint16_t flags;
+    uint32_t session_id;
+    int64_t seq;
+  };
+
+  static_assert(sizeof(MessageHeaderV2) == sizeof(MessageHeader), "MessageHeaderV2 must be as big as MessageHeader");
+  static_assert(offsetof(MessageHeaderV2, message_type) == offsetof(MessageHeader, message_type), "message_type offset");
+  static_assert(offsetof(MessageHeaderV2, message_size) == offsetof(MessageHeader, message_size), "message_size offset");
+  static_assert(offsetof(MessageHeaderV2, seq) == offsetof(MessageHeader, seq), "seq offset");
+
+  struct TradeMessageV2 : MessageHeaderV2
+  {
+    Price price;
+    Qty quantity;
+    int64_t timestamp;
+    PackedEnum<Side> side;
+    uint8_t reserved[7];
+
+    TradeMessageV2()
+    {
+      message_type = MessageType::TRADE_V2;
+      message_size = sizeof(TradeMessageV2);
+      version = 2;
+    }
+  };
+
+  static_assert(sizeof(TradeMessageV2) == 56, "TradeMessageV2 must fit a cache line");
+  static_assert(offsetof(TradeMessageV2, price) == 24 && offsetof(TradeMessageV2, quantity) == 32 &&
+                    offsetof(TradeMessageV2, timestamp) == 40 && offsetof(TradeMessageV2, side) == 48,
+                "TradeMessageV2 layout");
+
+  struct BBOMessageV2 : MessageHeaderV2
+  {
+    Price bid_price;
+    Qty bid_quantity;
+    Price ask_price;
+    Qty ask_quantity;
+    int64_t timestamp;
+
+    BBOMessageV2()
+    {
+      message_type = MessageType::BBO_V2;
+      message_size = sizeof(BBOMessageV2);
+      version = 2;
+    }
+  };
+
+  static_assert(sizeof(BBOMessageV2) == 64, "BBOMessageV2 must fit a cache line");
+  static_assert(offsetof(BBOMessageV2, bid_price) == 24 && offsetof(BBOMessageV2, bid_quantity) == 32 &&
+                    offsetof(BBOMessageV2, ask_price) == 40 && offsetof(BBOMessageV2, ask_quantity) == 48 &&
+                    offsetof(BBOMessageV2, timestamp) == 56,
+                "BBOMessageV2 layout");
+
+  // the instrument is the header's instrument_id instead of a symbol
+  struct NewOrderMessageV2 : MessageHeaderV2
+  {
+    int64_t timestamp;
+    Price price;
+    Qty quantity;
+    PackedEnum<Side> side;
+    PackedEnum<OrderType> orderType;
+    PackedEnum<TimeInForce> timeInForce;
+    uint8_t reserved[5];
+    char clientOrderID[32];
+
+    NewOrderMessageV2()
+    {
+      message_type = MessageType::NEW_ORDER_V2;
+      message_size = sizeof(NewOrderMessageV2);
+      version = 2;
+    }
+  };
+
+  static_assert(sizeof(NewOrderMessageV2) == 88, "NewOrderMessageV2 size");
+  static_assert(offsetof(NewOrderMessageV2, timestamp) == 24 && offsetof(NewOrderMessageV2, price) == 32 &&
+                    offsetof(NewOrderMessageV2, quantity) == 40 && offsetof(NewOrderMessageV2, side) == 48 &&
+                    offsetof(NewOrderMessageV2, clientOrderID) == 56,
+                "NewOrderMessageV2 layout");
+
+  // one price level of a book message, quantity 0 removes the level
+  struct BookLevel
+  {
+    int64_t price;
+    int64_t quantity;
+    PackedEnum<Side> side;
+    uint8_t reserved[7];
+  };
+
+  static_assert(sizeof(BookLevel) == 24, "BookLevel size");
+
+  // Incremental level 2 update: the levels that changed since the previous delta of the instrument
+  // book_seq counts the instrument's deltas, a consumer that sees it skip must resync from a BookSnapshotMessage.
+  // Only cnt levels are sent, message_size covers just those
+  struct BookDeltaMessage : MessageHeaderV2
+  {
+    static constexpr uint16_t MAX_LEVELS = 40;
+
+    int64_t book_seq;
+    int64_t timestamp;
+    uint16_t cnt;
+    uint8_t reserved[6];
+    BookLevel levels[MAX_LEVELS];
+
+    BookDeltaMessage()
+    {
+      message_type = MessageType::BOOK_DELTA;
+      version = 2;
+      setCount(0);
+    }
+
+    void setCount(uint16_t n)
+    {
+      cnt = n;
+      message_size = offsetof(BookDeltaMessage, levels) + n * sizeof(BookLevel);
+    }
+  };
+
+  static_assert(offsetof(BookDeltaMessage, book_seq) == 24 && offsetof(BookDeltaMessage, timestamp) == 32 &&
+                    offsetof(BookDeltaMessage, cnt) == 40 && offsetof(BookDeltaMessage, levels) == 48,
+                "BookDeltaMessage layout");
+  static_assert(sizeof(BookDeltaMessage) <= MAX_MESSAGE_SIZE, "BookDeltaMessage must fit a Message");
+
+  // Full depth as of delta book_seq, split into chunk_cnt chunks of up to MAX_LEVELS levels
+  // Only cnt levels are sent, message_size covers just those
+  struct BookSnapshotMessage : MessageHeaderV2
+  {
+    static constexpr uint16_t MAX_LEVELS = 40;
+
+    int64_t book_seq;
+    int64_t timestamp;
+    uint16_t chunk;
+    uint16_t chunk_cnt;
+    uint16_t cnt;
+    uint8_t reserved[2];
+    BookLevel levels[MAX_LEVELS];
+
+    BookSnapshotMessage()
+    {
+      message_type = MessageType::BOOK_SNAPSHOT;
+      version = 2;
+      chunk = 0;
+      chunk_cnt = 1;
+      setCount(0);
+    }
+
+    void setCount(uint16_t n)
+    {
+      cnt = n;
+      message_size = offsetof(BookSnapshotMessage, levels) + n * sizeof(BookLevel);
+    }
+  };
+
+  static_assert(offsetof(BookSnapshotMessage, book_seq) == 24 && offsetof(BookSnapshotMessage, timestamp) == 32 &&
+                    offsetof(BookSnapshotMessage, chunk) == 40 && offsetof(BookSnapshotMessage, cnt) == 44 &&
+                    offsetof(BookSnapshotMessage, levels) == 48,
+                "BookSnapshotMessage layout");
+  static_assert(sizeof(BookSnapshotMessage) <= MAX_MESSAGE_SIZE, "BookSnapshotMessage must fit a Message");
+#pragma GCC diagnostic pop
+}
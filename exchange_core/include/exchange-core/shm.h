@@ -3,52 +3,275 @@
 #include <sys/shm.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <dirent.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include "WFSPSC.h"
 #include "WFSPMC.h"
+#include "SPSCVarQueue.h"
 #include "message.h"
 #include <string>
 
 namespace exchange_core
 {
+  // How shmmap backs and prepares a mapping
+  struct ShmOptions
+  {
+    // back the segment with huge pages from a hugetlbfs mount, falls back to regular shm with
+    // MADV_HUGEPAGE when the mount or enough free huge pages are not available
+    bool hugePages = false;
+    std::string hugetlbfsDir = "/dev/hugepages";
+    // fault in every page at map time instead of on the first touch from the hot path
+    bool prefault = false;
+    // lock the pages in RAM
+    bool lock = false;
+    // NUMA node to bind the pages to, -1 leaves placement to whichever process touches a page first
+    int numaNode = -1;
+    // bind to the node of this cpu instead, e.g. the cpu the producer or the consumer is pinned to
+    int numaCpu = -1;
+  };
+
+  // NUMA node of a cpu, -1 if the kernel doesn't expose one
+  inline int cpuNumaNode(int cpu)
+  {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    if (!dir)
+      return -1;
+    int node = -1;
+    while (struct dirent *ent = readdir(dir))
+    {
+      if (strncmp(ent->d_name, "node", 4) == 0 && isdigit(ent->d_name[4]))
+      {
+        node = atoi(ent->d_name + 4);
+        break;
+      }
+    }
+    closedir(dir);
+    return node;
+  }
+
+  inline int numaNode(const ShmOptions &options)
+  {
+    if (options.numaNode >= 0)
+      return options.numaNode;
+    if (options.numaCpu >= 0)
+      return cpuNumaNode(options.numaCpu);
+    return -1;
+  }
+
+  // binds [addr, addr + size) to node, pages already faulted in are migrated if no other process maps them
+  inline bool numaBind(void *addr, size_t size, int node)
+  {
+    std::vector<unsigned long> mask(node / (8 * sizeof(unsigned long)) + 1);
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    if (::syscall(SYS_mbind, addr, size, MPOL_BIND, mask.data(), mask.size() * 8 * sizeof(unsigned long) + 1, MPOL_MF_MOVE))
+    {
+      std::cerr << "mbind to node " << node << " failed: " << strerror(errno) << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // number of pages of [addr, addr + size) on each NUMA node, pages that are not faulted in yet are not counted
+  inline std::map<int, size_t> numaPageNodes(const void *addr, size_t size)
+  {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    size_t cnt = (size + pageSize - 1) / pageSize;
+    std::vector<void *> pages(cnt);
+    std::vector<int> status(cnt, -1);
+    for (size_t i = 0; i < cnt; i++)
+      pages[i] = (uint8_t *)addr + i * pageSize;
+    std::map<int, size_t> ret;
+    if (::syscall(SYS_move_pages, 0, cnt, pages.data(), nullptr, status.data(), 0))
+    {
+      std::cerr << "move_pages failed: " << strerror(errno) << std::endl;
+      return ret;
+    }
+    for (int node : status)
+    {
+      if (node >= 0)
+        ret[node]++;
+    }
+    return ret;
+  }
+
   template <class T>
-  T *shmmap(const std::string &filename)
+  std::map<int, size_t> numaPageNodes(const T *shm)
+  {
+    return numaPageNodes(shm, sizeof(T));
+  }
+
+  // MAP_POPULATE would fault pages in before mbind gets a chance to place them
+  inline int mapFlags(const ShmOptions &options)
+  {
+    return MAP_SHARED | (options.prefault && numaNode(options) < 0 ? MAP_POPULATE : 0);
+  }
+
+  inline std::string hugetlbfsPath(const std::string &filename, const ShmOptions &options)
+  {
+    return options.hugetlbfsDir + "/" + (filename[0] == '/' ? filename.substr(1) : filename);
+  }
+
+  // a hugetlbfs mapping spans whole huge pages
+  inline size_t hugeRound(size_t size, size_t pageSize)
+  {
+    return (size + pageSize - 1) / pageSize * pageSize;
+  }
+
+  // maps a hugetlbfs file, returns nullptr if huge pages can't be used for it, or MAP_FAILED if the file
+  // exists with a different size, i.e. it holds another layout that must not be reinterpreted
+  inline void *hugemap(const std::string &filename, size_t &size, const ShmOptions &options)
   {
-    int fd = shm_open(filename.c_str(), O_CREAT | O_RDWR, 0666);
-    if (fd == -1)
+    std::string path = hugetlbfsPath(filename, options);
+    bool created = true;
+    int fd = open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd == -1 && errno == EEXIST)
     {
-      std::cerr << "shm_open failed: " << strerror(errno) << std::endl;
-      return nullptr;
+      created = false;
+      fd = open(path.c_str(), O_RDWR);
     }
-    if (ftruncate(fd, sizeof(T)))
+    void *ret = MAP_FAILED;
+    struct statfs fs;
+    if (fd != -1 && fstatfs(fd, &fs) == 0)
     {
-      std::cerr << "ftruncate failed: " << strerror(errno) << std::endl;
+      size_t len = hugeRound(size, fs.f_bsize);
+      struct stat st;
+      if (!created && fstat(fd, &st) == 0 && st.st_size && (size_t)st.st_size != len)
+      {
+        std::cerr << path << " has size " << st.st_size << ", expected " << len << std::endl;
+        close(fd);
+        return MAP_FAILED;
+      }
+      if (ftruncate(fd, len) == 0)
+        ret = mmap(0, len, PROT_READ | PROT_WRITE, mapFlags(options), fd, 0);
+      if (ret != MAP_FAILED)
+        size = len;
+    }
+    if (ret == MAP_FAILED)
+    {
+      std::cerr << "huge pages unavailable for " << path << ", falling back to shm: " << strerror(errno) << std::endl;
+      // don't leave a file behind that would make other processes disagree on where the segment lives
+      if (created && fd != -1)
+        unlink(path.c_str());
+      ret = nullptr;
+    }
+    if (fd != -1)
       close(fd);
+    return ret;
+  }
+
+  // mappedSize, if given, receives the length that was mapped: sizeof(T), or sizeof(T) rounded up to whole
+  // huge pages for a hugetlbfs mapping; pass it to shmunmap()
+  template <class T>
+  T *shmmap(const std::string &filename, const ShmOptions &options = ShmOptions(), size_t *mappedSize = nullptr)
+  {
+    size_t size = sizeof(T);
+    T *ret = options.hugePages ? (T *)hugemap(filename, size, options) : nullptr;
+    if (ret == MAP_FAILED)
       return nullptr;
+    bool huge = ret != nullptr;
+    if (!huge)
+    {
+      int fd = shm_open(filename.c_str(), O_CREAT | O_RDWR, 0666);
+      if (fd == -1)
+      {
+        std::cerr << "shm_open failed: " << strerror(errno) << std::endl;
+        return nullptr;
+      }
+      // an existing segment of another size was created for a different layout, don't resize it under its users
+      struct stat st;
+      if (fstat(fd, &st) == 0 && st.st_size && (size_t)st.st_size != size)
+      {
+        std::cerr << "shm " << filename << " has size " << st.st_size << ", expected " << size << std::endl;
+        close(fd);
+        return nullptr;
+      }
+      if (ftruncate(fd, size))
+      {
+        std::cerr << "ftruncate failed: " << strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+      }
+      ret = (T *)mmap(0, size, PROT_READ | PROT_WRITE, mapFlags(options), fd, 0);
+      close(fd);
+      if (ret == MAP_FAILED)
+      {
+        std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+        return nullptr;
+      }
     }
-    T *ret = (T *)mmap(0, sizeof(T), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    close(fd);
-    if (ret == MAP_FAILED)
+    if (options.hugePages && !huge)
+    {
+      // only effective when /sys/kernel/mm/transparent_hugepage/shmem_enabled allows it
+      madvise(ret, size, MADV_HUGEPAGE);
+    }
+    int node = numaNode(options);
+    if (node >= 0)
+    {
+      numaBind(ret, size, node);
+    }
+    if (options.prefault)
+    {
+      // MAP_POPULATE only read-faults shared mappings, a no-op atomic add write-faults every page
+      // without disturbing what another process may be writing
+      long pageSize = sysconf(_SC_PAGESIZE);
+      for (size_t off = 0; off < size; off += pageSize)
+        __atomic_fetch_add(reinterpret_cast<uint8_t *>(ret) + off, 0, __ATOMIC_RELAXED);
+    }
+    if (options.lock && mlock(ret, size))
     {
-      std::cerr << "mmap failed: " << strerror(errno) << std::endl;
+      std::cerr << "mlock failed: " << strerror(errno) << std::endl;
+    }
+    if (!ret->shmInit())
+    {
+      munmap(ret, size);
       return nullptr;
     }
-    ret->shmInit();
+    if (mappedSize)
+      *mappedSize = size;
     return ret;
   }
 
+  // unmaps what shmmap<T>() mapped, size is the length it reported through mappedSize
+  template <class T>
+  bool shmunmap(T *shm, size_t size = sizeof(T))
+  {
+    if (!shm || munmap(shm, size) == 0)
+      return true;
+    std::cerr << "munmap failed: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  // removes the segment from shm and, if it was created there, from hugetlbfs
+  inline void shmremove(const std::string &filename, const ShmOptions &options = ShmOptions())
+  {
+    shm_unlink(filename.c_str());
+    if (options.hugePages)
+      unlink(hugetlbfsPath(filename, options).c_str());
+  }
+
   using Queue = WFSPSC<Message, 1024 * 16>;
   using MulticastQueue = WFSPMC<Message, 1024*16>;
+  // holds as many BBOMessages as Queue in 1/8 of the memory
+  using VarQueue = SPSCVarQueue<1024 * 1024 * 2>;
+
+  Queue *getQueue(const std::string & name, const ShmOptions &options = ShmOptions())
+  {
+    return shmmap<Queue>(name, options);
+  };
 
-  Queue *getQueue(const std::string & name)
+  MulticastQueue *getMulticastQueue(const std::string & name, const ShmOptions &options = ShmOptions())
   {
-    return shmmap<Queue>(name);
+    return shmmap<MulticastQueue>(name, options);
   };
 
-  MulticastQueue *getMulticastQueue(const std::string & name)
+  VarQueue *getVarQueue(const std::string & name, const ShmOptions &options = ShmOptions())
   {
-    return shmmap<MulticastQueue>(name);
+    return shmmap<VarQueue>(name, options);
   };
 
 }
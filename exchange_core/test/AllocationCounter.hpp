@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// counts heap allocations made by this test binary while enabled
+namespace allocation_counter
+{
+  inline std::atomic<bool> enabled{false};
+  inline std::atomic<long> count{0};
+}
+
+// GCC can't tell these replace the global ones
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(size_t size)
+{
+  if (allocation_counter::enabled)
+    allocation_counter::count++;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  std::free(p);
+}
+#pragma GCC diagnostic pop
@@ -0,0 +1,81 @@
+#pragma once
+#include <gtest/gtest.h>
+
+#include "exchange-core/BookBuilder.h"
+
+namespace
+{
+  exchange_core::BookDeltaMessage makeDelta(int64_t seq, std::initializer_list<exchange_core::BookLevel> levels)
+  {
+    exchange_core::BookDeltaMessage msg;
+    msg.book_seq = seq;
+    uint16_t n = 0;
+    for (auto &level : levels)
+      msg.levels[n++] = level;
+    msg.setCount(n);
+    return msg;
+  }
+}
+
+TEST(bookBuilder, deltasAndSnapshot)
+{
+  using exchange_core::Side;
+  exchange_core::BookBuilder producer;
+  producer.clear();
+  std::vector<exchange_core::BookDeltaMessage> stream;
+  stream.push_back(makeDelta(1, {{100, 5, Side::BUY, {}}, {101, 3, Side::SELL, {}}}));
+  stream.push_back(makeDelta(2, {{99, 7, Side::BUY, {}}, {102, 4, Side::SELL, {}}, {100, 6, Side::BUY, {}}}));
+  stream.push_back(makeDelta(3, {{101, 0, Side::SELL, {}}}));
+  for (int i = 1; i <= 50; i++)
+    stream.push_back(makeDelta(3 + i, {{90 - i, i, Side::BUY, {}}}));
+  for (auto &msg : stream)
+    ASSERT_TRUE(producer.onDelta(msg));
+  EXPECT_EQ(stream[0].message_size, 48 + 2 * sizeof(exchange_core::BookLevel));
+
+  ASSERT_EQ(producer.getBids().size(), 52u);
+  EXPECT_EQ(producer.getBids()[0].price, 100);
+  EXPECT_EQ(producer.getBids()[0].quantity, 6);
+  EXPECT_EQ(producer.getBids()[1].price, 99);
+  ASSERT_EQ(producer.getAsks().size(), 1u);
+  EXPECT_EQ(producer.getAsks()[0].price, 102);
+
+  // a consumer joining late ignores deltas until it has a snapshot
+  exchange_core::BookBuilder consumer;
+  EXPECT_FALSE(consumer.onDelta(stream.back()));
+  std::vector<exchange_core::BookSnapshotMessage> chunks;
+  exchange_core::BookSnapshotMessage snapshot;
+  producer.makeSnapshot(snapshot, [&](const exchange_core::BookSnapshotMessage &chunk)
+                        { chunks.push_back(chunk); });
+  ASSERT_EQ(chunks.size(), 2u);
+  EXPECT_FALSE(consumer.onSnapshot(chunks[0]));
+  EXPECT_TRUE(consumer.onSnapshot(chunks[1]));
+  EXPECT_EQ(consumer.getState(), exchange_core::BookBuilder::State::LIVE);
+  EXPECT_EQ(consumer.getBookSeq(), 53);
+
+  // deltas already in the snapshot are ignored, the next one applies
+  EXPECT_FALSE(consumer.onDelta(stream.back()));
+  auto next = makeDelta(54, {{102, 0, Side::SELL, {}}, {103, 1, Side::SELL, {}}});
+  ASSERT_TRUE(producer.onDelta(next));
+  ASSERT_TRUE(consumer.onDelta(next));
+  ASSERT_EQ(consumer.getBids().size(), producer.getBids().size());
+  for (size_t i = 0; i < consumer.getBids().size(); i++)
+  {
+    EXPECT_EQ(consumer.getBids()[i].price, producer.getBids()[i].price);
+    EXPECT_EQ(consumer.getBids()[i].quantity, producer.getBids()[i].quantity);
+  }
+  ASSERT_EQ(consumer.getAsks().size(), 1u);
+  EXPECT_EQ(consumer.getAsks()[0].price, 103);
+
+  // a gap makes the book stale until the next snapshot
+  EXPECT_FALSE(consumer.onDelta(makeDelta(56, {{104, 1, Side::SELL, {}}})));
+  EXPECT_EQ(consumer.getState(), exchange_core::BookBuilder::State::STALE);
+  EXPECT_FALSE(consumer.onDelta(makeDelta(57, {{104, 1, Side::SELL, {}}})));
+  chunks.clear();
+  producer.makeSnapshot(snapshot, [&](const exchange_core::BookSnapshotMessage &chunk)
+                        { chunks.push_back(chunk); });
+  // a missing chunk doesn't complete the snapshot
+  EXPECT_FALSE(consumer.onSnapshot(chunks[1]));
+  EXPECT_FALSE(consumer.onSnapshot(chunks[0]));
+  EXPECT_TRUE(consumer.onSnapshot(chunks[1]));
+  EXPECT_EQ(consumer.getState(), exchange_core::BookBuilder::State::LIVE);
+}
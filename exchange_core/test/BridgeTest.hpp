@@ -0,0 +1,165 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "exchange-core/WFSPMC.h"
+#include "exchange-core/Bridge.h"
+
+TEST(bridge, loopbackWithLateJoiner)
+{
+  using Q = exchange_core::WFSPMC<exchange_core::Message, 256>;
+  auto source = std::make_unique<Q>();
+  auto live = std::make_unique<Q>();
+  auto late = std::make_unique<Q>();
+  uint16_t port = 20000 + getpid() % 20000;
+  std::string group = "239.255.0.1";
+
+  exchange_core::BridgePublisher<Q> publisher;
+  ASSERT_TRUE(publisher.open(source.get(), group, port, port + 1, "127.0.0.1"));
+  exchange_core::BridgeReceiver<Q> liveReceiver;
+  ASSERT_TRUE(liveReceiver.open(live.get(), group, port, "127.0.0.1", port + 1, 0, "127.0.0.1"));
+
+  // the receivers wait on the publisher while they drain, so it runs on its own thread
+  std::atomic<bool> running{true};
+  std::thread thr([&]
+                  { while (running) publisher.runOnce(); });
+
+  auto publish = [&](int from, int to)
+  {
+    for (int i = from; i <= to; i++)
+      source->tryVisitPush([&](exchange_core::Message &m)
+                           {
+                             auto *bbo = new (&m) exchange_core::BBOMessage();
+                             bbo->instrument_id = i; });
+  };
+  auto drain = [](exchange_core::BridgeReceiver<Q> &receiver, int64_t cnt)
+  {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (receiver.getNextSeq() <= cnt && std::chrono::steady_clock::now() < deadline)
+      receiver.runOnce();
+  };
+
+  publish(1, 100);
+  drain(liveReceiver, 100);
+  EXPECT_EQ(liveReceiver.getNextSeq(), 101);
+
+  // joins after 100 messages and asks for everything from seq 1
+  exchange_core::BridgeReceiver<Q> lateReceiver;
+  ASSERT_TRUE(lateReceiver.open(late.get(), group, port, "127.0.0.1", port + 1, 1, "127.0.0.1"));
+  publish(101, 110);
+  drain(liveReceiver, 110);
+  drain(lateReceiver, 110);
+  running = false;
+  thr.join();
+
+  EXPECT_EQ(lateReceiver.getGapCount(), 1);
+  EXPECT_EQ(lateReceiver.getLostCount(), 0);
+  for (auto *q : {live.get(), late.get()})
+  {
+    ASSERT_EQ(q->getCurrentWriteIdx(), 110);
+    for (int64_t idx = 1; idx <= 110; idx++)
+    {
+      exchange_core::Message m;
+      ASSERT_EQ(q->tryRead(m, idx), exchange_core::ReadResult::OK);
+      auto &bbo = reinterpret_cast<exchange_core::BBOMessage &>(m);
+      EXPECT_EQ(bbo.seq, idx);
+      EXPECT_EQ(bbo.message_type, exchange_core::MessageType::BBO);
+      EXPECT_EQ(bbo.instrument_id, idx);
+    }
+  }
+}
+
+TEST(bridge, stalledRetransmit)
+{
+  using Q = exchange_core::WFSPMC<exchange_core::Message, 256>;
+  auto source = std::make_unique<Q>();
+  auto late = std::make_unique<Q>();
+  uint16_t port = 20000 + (getpid() + 7) % 20000;
+  std::string group = "239.255.0.2";
+
+  // a retransmit server that accepts connections but never answers
+  int stalled = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  ASSERT_TRUE(exchange_core::bridge::sockaddrOf("127.0.0.1", port + 2, addr));
+  int on = 1;
+  setsockopt(stalled, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  ASSERT_EQ(bind(stalled, (sockaddr *)&addr, sizeof(addr)), 0);
+  ASSERT_EQ(listen(stalled, 1), 0);
+
+  exchange_core::BridgePublisher<Q> publisher;
+  ASSERT_TRUE(publisher.open(source.get(), group, port, port + 1, "127.0.0.1"));
+  auto publish = [&](int from, int to)
+  {
+    for (int i = from; i <= to; i++)
+      source->tryVisitPush([&](exchange_core::Message &m)
+                           {
+                             auto *bbo = new (&m) exchange_core::BBOMessage();
+                             bbo->instrument_id = i; });
+    publisher.runOnce();
+  };
+
+  // joins after seq 1..10 and can't get them back
+  publish(1, 10);
+  exchange_core::BridgeReceiver<Q> receiver;
+  ASSERT_TRUE(receiver.open(late.get(), group, port, "127.0.0.1", port + 2, 1, "127.0.0.1"));
+  publish(11, 20);
+  auto slowest = std::chrono::steady_clock::duration::zero();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (receiver.getNextSeq() <= 20 && std::chrono::steady_clock::now() < deadline)
+  {
+    auto start = std::chrono::steady_clock::now();
+    receiver.runOnce();
+    slowest = std::max(slowest, std::chrono::steady_clock::now() - start);
+  }
+
+  // UDP kept being drained while the retransmit timed out, and what it held was pushed afterwards
+  EXPECT_LT(slowest, std::chrono::milliseconds(exchange_core::bridge::RETRANSMIT_TIMEOUT_MS / 2));
+  EXPECT_EQ(receiver.getGapCount(), 1);
+  EXPECT_EQ(receiver.getLostCount(), 10);
+  EXPECT_EQ(receiver.getNextSeq(), 21);
+  ASSERT_EQ(late->getCurrentWriteIdx(), 10);
+  for (int64_t idx = 1; idx <= 10; idx++)
+  {
+    exchange_core::Message m;
+    ASSERT_EQ(late->tryRead(m, idx), exchange_core::ReadResult::OK);
+    EXPECT_EQ(reinterpret_cast<exchange_core::BBOMessage &>(m).seq, idx + 10);
+  }
+  receiver.close();
+  close(stalled);
+}
+
+TEST(bridge, reopen)
+{
+  using Q = exchange_core::WFSPMC<exchange_core::Message, 256>;
+  auto source = std::make_unique<Q>();
+  auto sink = std::make_unique<Q>();
+  uint16_t port = 20000 + (getpid() + 13) % 20000;
+  std::string group = "239.255.0.3";
+
+  // a second open() replaces the first one's sockets and thread
+  exchange_core::BridgePublisher<Q> publisher;
+  ASSERT_TRUE(publisher.open(source.get(), group, port, port + 1, "127.0.0.1"));
+  ASSERT_TRUE(publisher.open(source.get(), group, port, port + 1, "127.0.0.1"));
+  exchange_core::BridgeReceiver<Q> receiver;
+  ASSERT_TRUE(receiver.open(sink.get(), group, port, "127.0.0.1", port + 1, 0, "127.0.0.1"));
+  ASSERT_TRUE(receiver.open(sink.get(), group, port, "127.0.0.1", port + 1, 0, "127.0.0.1"));
+
+  // the retransmit port is taken, so the second publisher fails and gives its udp socket back
+  exchange_core::BridgePublisher<Q> other;
+  EXPECT_FALSE(other.open(source.get(), group, port, port + 1, "127.0.0.1"));
+
+  source->tryVisitPush([](exchange_core::Message &m)
+                       { new (&m) exchange_core::BBOMessage(); });
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (receiver.getNextSeq() <= 1 && std::chrono::steady_clock::now() < deadline)
+  {
+    publisher.runOnce();
+    receiver.runOnce();
+  }
+  EXPECT_EQ(receiver.getNextSeq(), 2);
+  EXPECT_EQ(sink->getCurrentWriteIdx(), 1);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "exchange-core/Clock.h"
+
+TEST(clock, tscClock)
+{
+  exchange_core::TscClock &clock = exchange_core::tscClock();
+  auto systemNow = []
+  { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); };
+  EXPECT_NEAR(clock.now(), systemNow(), 1000000);
+
+  uint64_t start = exchange_core::rdtsc();
+  int64_t start_ns = clock.now();
+  int64_t mono_start = exchange_core::clockNs(CLOCK_MONOTONIC);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  int64_t elapsed = clock.toNs(exchange_core::rdtsc() - start);
+  EXPECT_NEAR(elapsed, exchange_core::clockNs(CLOCK_MONOTONIC) - mono_start, 500000);
+  EXPECT_NEAR(clock.fromTicks(start), start_ns, 100000);
+
+  clock.calibrate();
+  EXPECT_NEAR(clock.now(), systemNow(), 1000000);
+}
+
+TEST(clock, coarseClock)
+{
+  exchange_core::TscClock clock;
+  clock.init(1000000);
+  exchange_core::CoarseClock coarse(clock);
+  int64_t first = coarse.nowNs();
+  EXPECT_EQ(coarse.nowNs(), first);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  EXPECT_GE(coarse.update(), first + 2000000);
+  EXPECT_EQ(coarse.nowMs(), coarse.nowNs() / 1000000);
+}
+
+TEST(clock, calibrator)
+{
+  exchange_core::TscClock clock;
+  clock.init(1000000);
+  {
+    // stops right away at the end of the scope rather than after its interval
+    exchange_core::TscCalibrator calibrator(clock, 1000000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  EXPECT_NEAR(clock.now(), exchange_core::clockNs(CLOCK_REALTIME), 1000000);
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    exchange_core::TscCalibrator calibrator(clock);
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+}
+
+TEST(clock, monotonicAcrossCalibration)
+{
+  exchange_core::TscClock clock;
+  clock.init(1000000);
+  int64_t offset = exchange_core::clockNs(CLOCK_REALTIME) - exchange_core::clockNs(CLOCK_MONOTONIC);
+  EXPECT_NEAR(clock.getOffset(), offset, 1000000);
+
+  std::atomic<bool> stop{false};
+  std::thread calibrator([&]
+                         {
+                           while (!stop)
+                             clock.calibrate(); });
+  int64_t last = clock.now();
+  int64_t backwards = 0;
+  for (int i = 0; i < 1000000; i++)
+  {
+    int64_t now = clock.now();
+    backwards += now < last;
+    last = now;
+  }
+  stop = true;
+  calibrator.join();
+  EXPECT_EQ(backwards, 0);
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+
+#include "exchange-core/Journal.h"
+
+TEST(journal, rollAndResume)
+{
+  char tmpl[] = "/tmp/exchange_core_journal_XXXXXX";
+  ASSERT_NE(mkdtemp(tmpl), nullptr);
+  std::string dir = tmpl;
+  {
+    exchange_core::JournalWriter<int64_t, 8> writer;
+    ASSERT_TRUE(writer.open(dir, "ticks"));
+    for (int64_t i = 1; i <= 20; i++)
+    {
+      ASSERT_TRUE(writer.tryPush(i * 10));
+      writer.maintain();
+    }
+    EXPECT_EQ(writer.getCurrentWriteIdx(), 20);
+  }
+  // a restarted writer appends after the last published idx
+  {
+    exchange_core::JournalWriter<int64_t, 8> writer;
+    ASSERT_TRUE(writer.open(dir, "ticks"));
+    EXPECT_EQ(writer.getCurrentWriteIdx(), 20);
+    ASSERT_TRUE(writer.emplace(210));
+  }
+
+  exchange_core::JournalReader<int64_t, 8> reader;
+  ASSERT_TRUE(reader.open(dir, "ticks"));
+  int64_t v, last_ts = 0;
+  for (int64_t idx = 1; idx <= 21; idx++)
+  {
+    ASSERT_TRUE(reader.tryRead(v, idx));
+    EXPECT_EQ(v, idx * 10);
+    int64_t ts = reader.getTimestamp(idx);
+    EXPECT_GE(ts, last_ts);
+    last_ts = ts;
+  }
+  EXPECT_FALSE(reader.tryRead(v, 22));
+  EXPECT_EQ(reader.getTimestamp(22), 0);
+  EXPECT_EQ(reader.getCurrentWriteIdx(21), 21);
+
+  // segments 0..2 hold idx 1..24, segment 3 was never needed
+  for (int seg = 0; seg < 3; seg++)
+    EXPECT_EQ(unlink(exchange_core::JournalSegment<int64_t, 8>::path(dir, "ticks", seg).c_str()), 0);
+  EXPECT_NE(unlink(exchange_core::JournalSegment<int64_t, 8>::path(dir, "ticks", 3).c_str()), 0);
+  rmdir(dir.c_str());
+}
+
+TEST(journal, resumeBeforePrecreatedSegment)
+{
+  char tmpl[] = "/tmp/exchange_core_journal_XXXXXX";
+  ASSERT_NE(mkdtemp(tmpl), nullptr);
+  std::string dir = tmpl;
+  using Segment = exchange_core::JournalSegment<int64_t, 8>;
+  {
+    exchange_core::JournalWriter<int64_t, 8> writer;
+    ASSERT_TRUE(writer.open(dir, "ticks"));
+    for (int64_t i = 1; i <= 6; i++)
+      ASSERT_TRUE(writer.tryPush(i * 10));
+    // creates segment 1 ahead of time, it stays empty
+    writer.maintain();
+    ASSERT_EQ(access(Segment::path(dir, "ticks", 1).c_str(), F_OK), 0);
+  }
+  {
+    exchange_core::JournalWriter<int64_t, 8> writer;
+    ASSERT_TRUE(writer.open(dir, "ticks"));
+    EXPECT_EQ(writer.getCurrentWriteIdx(), 6);
+    for (int64_t i = 7; i <= 10; i++)
+      ASSERT_TRUE(writer.tryPush(i * 10));
+  }
+
+  exchange_core::JournalReader<int64_t, 8> reader;
+  ASSERT_TRUE(reader.open(dir, "ticks"));
+  int64_t v;
+  for (int64_t idx = 1; idx <= 10; idx++)
+  {
+    ASSERT_TRUE(reader.tryRead(v, idx));
+    EXPECT_EQ(v, idx * 10);
+  }
+  EXPECT_FALSE(reader.tryRead(v, 11));
+
+  for (int seg = 0; seg < 2; seg++)
+    EXPECT_EQ(unlink(Segment::path(dir, "ticks", seg).c_str()), 0);
+  rmdir(dir.c_str());
+}
+
+TEST(journal, liveTail)
+{
+  char tmpl[] = "/tmp/exchange_core_journal_XXXXXX";
+  ASSERT_NE(mkdtemp(tmpl), nullptr);
+  std::string dir = tmpl;
+
+  exchange_core::JournalWriter<int64_t, 4> writer;
+  ASSERT_TRUE(writer.open(dir, "live"));
+  exchange_core::JournalReader<int64_t, 4> reader;
+  ASSERT_TRUE(reader.open(dir, "live"));
+
+  int64_t v;
+  for (int64_t idx = 1; idx <= 10; idx++)
+  {
+    EXPECT_FALSE(reader.tryRead(v, idx));
+    ASSERT_TRUE(writer.tryPush(idx));
+    ASSERT_TRUE(reader.tryRead(v, idx));
+    EXPECT_EQ(v, idx);
+  }
+
+  for (int seg = 0; seg < 3; seg++)
+    unlink(exchange_core::JournalSegment<int64_t, 4>::path(dir, "live", seg).c_str());
+  rmdir(dir.c_str());
+}
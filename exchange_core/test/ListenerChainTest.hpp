@@ -0,0 +1,70 @@
+#pragma once
+#include <gtest/gtest.h>
+
+#include "exchange-core/ListenerChain.h"
+
+namespace
+{
+  struct TradeCounter
+  {
+    void onTrade(const exchange_core::FeedTrade &trade)
+    {
+      cnt++;
+      last = trade.price;
+    }
+    int cnt = 0;
+    exchange_core::Price last;
+  };
+
+  struct ReportCounter
+  {
+    void onExecutionReport(const exchange_core::ExecutionReport &)
+    {
+      cnt++;
+    }
+    int cnt = 0;
+  };
+
+  struct VirtualListener : exchange_core::MarketDataEventListener
+  {
+    void onOrderBook(const exchange_core::OrderBook &) override
+    {
+      books++;
+    }
+    void onTrade(const exchange_core::FeedTrade &) override
+    {
+      trades++;
+    }
+    int books = 0;
+    int trades = 0;
+  };
+}
+
+TEST(listenerChain, dispatch)
+{
+  TradeCounter trades;
+  ReportCounter reports;
+  VirtualListener registered;
+  exchange_core::MarketDataListeners virtuals;
+  EXPECT_TRUE(exchange_core::addListener(virtuals, registered));
+
+  using Chain = exchange_core::ListenerChain<TradeCounter, ReportCounter, exchange_core::MarketDataListeners>;
+  Chain chain(trades, reports, virtuals);
+  exchange_core::FeedTrade trade{};
+  trade.price = exchange_core::Price(42);
+  chain.onTrade(trade);
+  chain.onTrade(trade);
+  exchange_core::OrderBook book{};
+  chain.onOrderBook(book);
+  chain.onExecutionReport(exchange_core::ExecutionReport{});
+  // nobody in the chain takes balance reports
+  chain.onBalanceReport(exchange_core::BalanceReport{});
+
+  EXPECT_EQ(trades.cnt, 2);
+  EXPECT_EQ(trades.last, exchange_core::Price(42));
+  EXPECT_EQ(reports.cnt, 1);
+  EXPECT_EQ(registered.trades, 2);
+  EXPECT_EQ(registered.books, 1);
+  EXPECT_EQ(&chain.get<0>(), &trades);
+  EXPECT_FALSE(exchange_core::addListener(chain, registered));
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <gtest/gtest.h>
+
+#include "exchange-core/MessageDispatcher.h"
+
+namespace
+{
+  struct CountingHandler
+  {
+    int trades = 0;
+    int bbos = 0;
+    int deltas = 0;
+    int snapshots = 0;
+    int64_t last_price = 0;
+
+    void operator()(const exchange_core::TradeMessage &msg)
+    {
+      trades++;
+      last_price = (int64_t)msg.price;
+    }
+
+    void operator()(const exchange_core::BBOMessageV2 &msg)
+    {
+      bbos++;
+      last_price = msg.bid_price.raw();
+    }
+
+    void operator()(const exchange_core::BookDeltaMessage &msg)
+    {
+      deltas += msg.cnt;
+    }
+
+    void operator()(const exchange_core::BookSnapshotMessage &msg)
+    {
+      snapshots += msg.cnt;
+    }
+  };
+}
+
+TEST(messageDispatcher, dispatch)
+{
+  using Dispatcher = exchange_core::MessageDispatcher<CountingHandler>;
+  static_assert(Dispatcher::handles<exchange_core::TradeMessage>(), "");
+  static_assert(!Dispatcher::handles<exchange_core::BBOMessage>(), "");
+
+  CountingHandler handler;
+  exchange_core::TradeMessage trade;
+  trade.price = 42;
+  EXPECT_TRUE(exchange_core::dispatch(trade, handler));
+  EXPECT_EQ(handler.trades, 1);
+  EXPECT_EQ(handler.last_price, 42);
+
+  exchange_core::BBOMessageV2 bbo;
+  bbo.bid_price = exchange_core::Price(7);
+  EXPECT_TRUE(exchange_core::dispatch(reinterpret_cast<const exchange_core::MessageHeader &>(bbo), handler));
+  EXPECT_EQ(handler.bbos, 1);
+  EXPECT_EQ(handler.last_price, 7);
+
+  // variable size within bounds
+  exchange_core::BookDeltaMessage delta;
+  delta.setCount(3);
+  EXPECT_TRUE(exchange_core::dispatch(reinterpret_cast<const exchange_core::MessageHeader &>(delta), handler));
+  EXPECT_EQ(handler.deltas, 3);
+
+  // no overload, unknown type, bad size
+  EXPECT_FALSE(exchange_core::dispatch(exchange_core::BBOMessage(), handler));
+  exchange_core::Message unknown;
+  unknown.message_type = 100;
+  unknown.message_size = sizeof(exchange_core::MessageHeader);
+  EXPECT_FALSE(exchange_core::dispatch(unknown, handler));
+  unknown.message_type = 1000;
+  EXPECT_FALSE(exchange_core::dispatch(unknown, handler));
+  trade.message_size = sizeof(trade) - 8;
+  EXPECT_FALSE(exchange_core::dispatch(trade, handler));
+  EXPECT_EQ(handler.trades, 1);
+
+  // book levels beyond message_size or the capacity
+  delta.setCount(2);
+  delta.cnt = 3;
+  EXPECT_FALSE(exchange_core::dispatch(reinterpret_cast<const exchange_core::MessageHeader &>(delta), handler));
+  delta.setCount(exchange_core::BookDeltaMessage::MAX_LEVELS);
+  delta.cnt = exchange_core::BookDeltaMessage::MAX_LEVELS + 1;
+  EXPECT_FALSE(exchange_core::dispatch(reinterpret_cast<const exchange_core::MessageHeader &>(delta), handler));
+  exchange_core::BookSnapshotMessage snapshot;
+  snapshot.setCount(1);
+  EXPECT_TRUE(exchange_core::dispatch(reinterpret_cast<const exchange_core::MessageHeader &>(snapshot), handler));
+  snapshot.cnt = 200;
+  EXPECT_FALSE(exchange_core::dispatch(reinterpret_cast<const exchange_core::MessageHeader &>(snapshot), handler));
+  EXPECT_EQ(handler.deltas, 3);
+  EXPECT_EQ(handler.snapshots, 1);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <memory>
+
+#include "exchange-core/message.h"
+#include "exchange-core/SPSCVarQueue.h"
+
+TEST(message, v2Layout)
+{
+  exchange_core::TradeMessageV2 trade;
+  trade.instrument_id = 7;
+  trade.exchange = exchange_core::ExchangeEnum::PHEMEX;
+  trade.side = exchange_core::Side::SELL;
+  // Phemex priceEp scale, round trips without going through a double
+  trade.price = exchange_core::Price(423215000);
+  EXPECT_EQ(trade.message_type, exchange_core::MessageType::TRADE_V2);
+  EXPECT_EQ(trade.message_size, 56);
+  EXPECT_EQ(trade.exchange, exchange_core::ExchangeEnum::PHEMEX);
+  EXPECT_EQ(trade.side, exchange_core::Side::SELL);
+  EXPECT_EQ(exchange_core::Price::fromDouble(trade.price.toDouble(10000), 10000), trade.price);
+  EXPECT_EQ(exchange_core::Price::fromDouble(0.3, 10000).raw(), 3000);
+
+  // v2 messages travel through the same queues as v1 ones, one block each
+  auto q = std::make_unique<exchange_core::SPSCVarQueue<4096>>();
+  exchange_core::BBOMessageV2 bbo;
+  bbo.seq = 42;
+  ASSERT_TRUE(q->tryPush(reinterpret_cast<const exchange_core::MessageHeader &>(bbo)));
+  EXPECT_EQ(q->size(), 1);
+  ASSERT_TRUE(q->tryVisitPop([](const exchange_core::MessageHeader &header)
+                            {
+                              EXPECT_EQ(header.message_type, exchange_core::MessageType::BBO_V2);
+                              EXPECT_EQ(header.seq, 42); }));
+
+  EXPECT_EQ(exchange_core::BalanceReportMessage().message_size, sizeof(exchange_core::BalanceReportMessage));
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <gtest/gtest.h>
+
+#include "AllocationCounter.hpp"
+#include "exchange-core/exchange-core.h"
+#include "exchange-core/ListenerChain.h"
+#include "exchange-core/PriceLadder.h"
+
+namespace
+{
+  struct BookListener : exchange_core::MarketDataEventListener
+  {
+    int64_t spread = 0;
+    size_t levels = 0;
+
+    void onOrderBook(const exchange_core::OrderBook &book) override
+    {
+      spread += (book.asks[0].price - book.bids[0].price).raw();
+      for (auto &level : book.bids)
+        levels += level.number_of_order;
+    }
+
+    void onTrade(const exchange_core::FeedTrade &) override
+    {
+    }
+  };
+}
+
+TEST(orderBook, noAllocationPerTick)
+{
+  BookListener listener;
+  exchange_core::MarketDataListeners listeners;
+  listeners.add(listener);
+  exchange_core::PriceLadder<> ladder(5);
+  for (int i = 0; i < 30; i++)
+  {
+    ladder.set(exchange_core::Side::BUY, 1000 - i * 5, i + 1);
+    ladder.set(exchange_core::Side::SELL, 1005 + i * 5, i + 1);
+  }
+  exchange_core::OrderBook book;
+
+  allocation_counter::count = 0;
+  allocation_counter::enabled = true;
+  for (int tick = 0; tick < 10000; tick++)
+  {
+    // what a MarketDataService does on every book update
+    ladder.set(exchange_core::Side::BUY, 1000 - (tick % 30) * 5, tick % 7 + 1);
+    exchange_core::fillOrderBook(book, exchange_core::ExchangeEnum::PHEMEX, 1, tick, ladder);
+    listeners.onOrderBook(book);
+  }
+  allocation_counter::enabled = false;
+
+  EXPECT_EQ(allocation_counter::count, 0);
+  EXPECT_EQ(book.bids.size(), exchange_core::ORDER_BOOK_DEPTH);
+  EXPECT_TRUE(book.asks.full());
+  EXPECT_EQ(book.bids[0].price.raw(), 1000);
+  EXPECT_EQ(book.asks[0].price.raw(), 1005);
+  EXPECT_EQ(book.asks[1].quantity.raw(), 2);
+  EXPECT_EQ(book.timestamp, 9999);
+  EXPECT_EQ(listener.levels, 10000 * exchange_core::ORDER_BOOK_DEPTH);
+  EXPECT_EQ(listener.spread, 10000 * 5);
+
+  // the counter itself works
+  allocation_counter::enabled = true;
+  auto *p = new int(1);
+  allocation_counter::enabled = false;
+  delete p;
+  EXPECT_EQ(allocation_counter::count, 1);
+}
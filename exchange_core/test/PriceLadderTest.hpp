@@ -0,0 +1,93 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+#include "exchange-core/PriceLadder.h"
+
+using Ladder = exchange_core::PriceLadder<128>;
+
+TEST(priceLadder, touch)
+{
+  Ladder ladder(5);
+  EXPECT_EQ(ladder.bestBid().quantity, 0);
+  ladder.set(exchange_core::Side::BUY, 1000, 3);
+  ladder.set(exchange_core::Side::BUY, 995, 4);
+  ladder.set(exchange_core::Side::SELL, 1005, 2);
+  ladder.set(exchange_core::Side::SELL, 1010, 6);
+  EXPECT_EQ(ladder.bestBid().price, 1000);
+  EXPECT_EQ(ladder.bestAsk().price, 1005);
+  ladder.set(exchange_core::Side::BUY, 1000, 0);
+  EXPECT_EQ(ladder.bestBid().price, 995);
+  EXPECT_EQ(ladder.bestBid().quantity, 4);
+  ladder.set(exchange_core::Side::SELL, 1005, 7);
+  EXPECT_EQ(ladder.bestAsk().quantity, 7);
+
+  // off the tick grid and far below the window, both go to the overflow
+  ladder.set(exchange_core::Side::BUY, 997, 1);
+  ladder.set(exchange_core::Side::BUY, 1, 9);
+  EXPECT_EQ(ladder.bestBid().price, 997);
+  EXPECT_EQ(ladder.quantity(exchange_core::Side::BUY, 1), 9);
+  EXPECT_EQ(ladder.size(exchange_core::Side::BUY), 3u);
+  std::vector<int64_t> prices;
+  ladder.visit(exchange_core::Side::BUY, 10, [&](const Ladder::Level &l)
+               { prices.push_back(l.price); });
+  EXPECT_EQ(prices, (std::vector<int64_t>{997, 995, 1}));
+
+  // the market moves far above the window
+  int64_t base = ladder.getBase();
+  ladder.set(exchange_core::Side::SELL, 100000, 1);
+  ladder.set(exchange_core::Side::BUY, 99000, 1);
+  EXPECT_NE(ladder.getBase(), base);
+  EXPECT_EQ(ladder.bestBid().price, 99000);
+  EXPECT_EQ(ladder.bestAsk().price, 1005);
+  EXPECT_EQ(ladder.quantity(exchange_core::Side::BUY, 995), 4);
+}
+
+// random walk of the mid with updates around it, checked against a std::map book
+TEST(priceLadder, randomWalk)
+{
+  std::mt19937_64 rng(42);
+  Ladder ladder(2);
+  std::map<int64_t, int64_t> bids, asks;
+  int64_t mid = 100000;
+  for (int i = 0; i < 200000; i++)
+  {
+    mid += 2 * (int64_t)(rng() % 3) - 2;
+    bool bid = rng() & 1;
+    int64_t offset = 2 * (1 + (int64_t)(std::geometric_distribution<int>(0.05)(rng)));
+    int64_t price = bid ? mid - offset : mid + offset;
+    int64_t qty = rng() % 4 ? rng() % 100 + 1 : 0;
+    auto &levels = bid ? bids : asks;
+    // a trade through the level clears the other side's crossing levels
+    if (qty)
+    {
+      auto &other = bid ? asks : bids;
+      for (auto it = other.begin(); it != other.end();)
+      {
+        if (bid ? it->first <= price : it->first >= price)
+        {
+          ladder.set(bid ? exchange_core::Side::SELL : exchange_core::Side::BUY, it->first, 0);
+          it = other.erase(it);
+        }
+        else
+          ++it;
+      }
+      levels[price] = qty;
+    }
+    else
+      levels.erase(price);
+    ladder.set(bid ? exchange_core::Side::BUY : exchange_core::Side::SELL, price, qty);
+
+    ASSERT_EQ(ladder.bestBid().price, bids.empty() ? 0 : bids.rbegin()->first);
+    ASSERT_EQ(ladder.bestAsk().price, asks.empty() ? 0 : asks.begin()->first);
+  }
+  EXPECT_EQ(ladder.size(exchange_core::Side::BUY), bids.size());
+  EXPECT_EQ(ladder.size(exchange_core::Side::SELL), asks.size());
+  auto it = bids.rbegin();
+  ladder.visit(exchange_core::Side::BUY, SIZE_MAX, [&](const Ladder::Level &l)
+               {
+                 EXPECT_EQ(l.price, it->first);
+                 EXPECT_EQ(l.quantity, it->second);
+                 ++it; });
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <cstdio>
+
+#include "AllocationCounter.hpp"
+#include "exchange-core/exchange-core.h"
+
+TEST(price, fixedPoint)
+{
+  exchange_core::Instrument btcusd;
+  btcusd.price_scale = 10000;
+  exchange_core::Price bid = btcusd.toPrice(40000.01);
+  exchange_core::Price ask(400001500);
+  EXPECT_EQ(bid.raw(), 400000100);
+  EXPECT_LT(bid, ask);
+  EXPECT_EQ((ask - bid).raw(), 1400);
+  EXPECT_EQ(bid + exchange_core::Price(1400), ask);
+  EXPECT_DOUBLE_EQ(btcusd.toDouble(ask), 40000.15);
+  // 0.1 + 0.2 != 0.3 in double, but it is on the grid
+  EXPECT_EQ(btcusd.toPrice(0.1) + btcusd.toPrice(0.2), btcusd.toPrice(0.3));
+  exchange_core::Qty qty(3);
+  qty += exchange_core::Qty(2);
+  EXPECT_EQ(qty * 2, exchange_core::Qty(10));
+}
+
+TEST(price, securityMasterScales)
+{
+  char path[] = "/tmp/exchange_core_instruments_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  std::string csv = "1,BTCUSD,10000\n2,ETHUSDT,100,1000\n3,LEGACY\n4,ZERO,0\n";
+  ASSERT_EQ(write(fd, csv.data(), csv.size()), (ssize_t)csv.size());
+  close(fd);
+
+  // missing scales default to 1 whether the CSV is parsed or its cache is mapped
+  exchange_core::SecurityMaster parsed, cached;
+  ASSERT_TRUE(parsed.load(path));
+  ASSERT_TRUE(cached.load(path));
+  unlink(path);
+  unlink((std::string(path) + ".bin").c_str());
+  for (auto *master : {&parsed, &cached})
+  {
+    EXPECT_EQ(master->getInstrument("BTCUSD").price_scale, 10000);
+    EXPECT_EQ(master->getInstrument("BTCUSD").qty_scale, 1);
+    EXPECT_EQ(master->getInstrument("ETHUSDT").price_scale, 100);
+    EXPECT_EQ(master->getInstrument("ETHUSDT").qty_scale, 1000);
+    EXPECT_EQ(master->getInstrument("ETHUSDT").toQty(0.25), exchange_core::Qty(250));
+    EXPECT_EQ(master->getInstrument("LEGACY").price_scale, 1);
+    EXPECT_EQ(master->getInstrument("LEGACY").qty_scale, 1);
+    EXPECT_EQ(master->find("ZERO"), nullptr);
+  }
+}
+
+TEST(price, securityMasterLookup)
+{
+  char path[] = "/tmp/exchange_core_instruments_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  std::string csv = "7,BTCUSD,10000,1,5000\r\n2,ETHUSDT,100,1000\nbad line\n";
+  ASSERT_EQ(write(fd, csv.data(), csv.size()), (ssize_t)csv.size());
+  close(fd);
+  std::string cache = std::string(path) + ".bin";
+
+  exchange_core::SecurityMaster parsed;
+  ASSERT_TRUE(parsed.load(path));
+  EXPECT_EQ(access(cache.c_str(), F_OK), 0);
+  EXPECT_EQ(parsed.size(), 2u);
+
+  // the second load maps the cache written by the first one
+  exchange_core::SecurityMaster cached;
+  ASSERT_TRUE(cached.load(path));
+  for (auto *master : {&parsed, &cached})
+  {
+    std::string_view symbol("ETHUSDT,100");
+    allocation_counter::count = 0;
+    allocation_counter::enabled = true;
+    const exchange_core::Instrument *eth = master->find(symbol.substr(0, 7));
+    const exchange_core::Instrument *btc = master->get(7);
+    const exchange_core::Instrument *none = master->find("XRPUSD");
+    allocation_counter::enabled = false;
+    EXPECT_EQ(allocation_counter::count, 0);
+    ASSERT_NE(eth, nullptr);
+    EXPECT_EQ(eth->instrument_id, 2);
+    EXPECT_EQ(eth->qty_scale, 1000);
+    ASSERT_NE(btc, nullptr);
+    EXPECT_EQ(btc->symbol, "BTCUSD");
+    EXPECT_EQ(btc->tick_size, 5000);
+    EXPECT_EQ(eth->tick_size, 0);
+    EXPECT_EQ(none, nullptr);
+    EXPECT_EQ(master->get(3), nullptr);
+    // a miss doesn't insert
+    EXPECT_EQ(master->getInstrument("XRPUSD").instrument_id, -1);
+    EXPECT_EQ(master->size(), 2u);
+  }
+
+  // a changed CSV invalidates the cache
+  std::ofstream(path, std::ios::app) << "3,XRPUSD,10000\n";
+  exchange_core::SecurityMaster reparsed;
+  ASSERT_TRUE(reparsed.load(path));
+  EXPECT_EQ(reparsed.size(), 3u);
+  ASSERT_NE(reparsed.find("XRPUSD"), nullptr);
+  unlink(path);
+  unlink(cache.c_str());
+}
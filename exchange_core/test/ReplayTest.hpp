@@ -0,0 +1,115 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "exchange-core/Replay.h"
+
+namespace
+{
+  struct ReplayJournals
+  {
+    std::string dir;
+
+    ReplayJournals()
+    {
+      char tmpl[] = "/tmp/exchange_core_replay_XXXXXX";
+      dir = mkdtemp(tmpl);
+    }
+
+    ~ReplayJournals()
+    {
+      for (auto name : {"a", "b"})
+        unlink(exchange_core::JournalSegment<int64_t, 16>::path(dir, name, 0).c_str());
+      rmdir(dir.c_str());
+    }
+  };
+}
+
+TEST(replay, mergesByCaptureTime)
+{
+  ReplayJournals journals;
+  {
+    exchange_core::JournalWriter<int64_t, 16> a, b;
+    ASSERT_TRUE(a.open(journals.dir, "a"));
+    ASSERT_TRUE(b.open(journals.dir, "b"));
+    // a gets 1, 4, 5, b gets 2, 3, 6
+    for (int64_t v : {1, 2, 3, 4, 5, 6})
+    {
+      ((v == 2 || v == 3 || v == 6) ? b : a).tryPush(v);
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+  }
+
+  exchange_core::Replayer<int64_t, 16> replayer(0);
+  ASSERT_TRUE(replayer.add(journals.dir, "a"));
+  ASSERT_TRUE(replayer.add(journals.dir, "b"));
+  EXPECT_FALSE(replayer.add(journals.dir, "missing"));
+  std::vector<int64_t> out;
+  int64_t last_ts = 0;
+  EXPECT_EQ(replayer.run([&](const int64_t &v, int64_t ts)
+                         {
+                           out.push_back(v);
+                           EXPECT_GE(ts, last_ts);
+                           last_ts = ts; }),
+            6);
+  EXPECT_EQ(out, (std::vector<int64_t>{1, 2, 3, 4, 5, 6}));
+  EXPECT_TRUE(replayer.done());
+}
+
+TEST(replay, speed)
+{
+  ReplayJournals journals;
+  {
+    exchange_core::JournalWriter<int64_t, 16> a;
+    ASSERT_TRUE(a.open(journals.dir, "a"));
+    a.tryPush(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    a.tryPush(2);
+  }
+
+  auto replayTime = [&](double speed)
+  {
+    exchange_core::Replayer<int64_t, 16> replayer(speed);
+    EXPECT_TRUE(replayer.add(journals.dir, "a"));
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(replayer.run([](const int64_t &, int64_t) {}), 2);
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  };
+  EXPECT_GE(replayTime(1), 40);
+  int64_t doubled = replayTime(2);
+  EXPECT_GE(doubled, 20);
+  EXPECT_LT(doubled, 40);
+  EXPECT_LT(replayTime(0), 20);
+}
+
+TEST(replay, followsLiveJournal)
+{
+  ReplayJournals journals;
+  exchange_core::JournalWriter<int64_t, 16> a, b;
+  ASSERT_TRUE(a.open(journals.dir, "a"));
+  ASSERT_TRUE(b.open(journals.dir, "b"));
+  a.tryPush(1);
+  a.tryPush(2);
+
+  exchange_core::Replayer<int64_t, 16> replayer(0);
+  ASSERT_TRUE(replayer.add(journals.dir, "a", 1, true));
+  // b has nothing yet, it isn't followed so it ends right away
+  ASSERT_TRUE(replayer.add(journals.dir, "b"));
+  std::vector<int64_t> out;
+  auto publish = [&](const int64_t &v, int64_t)
+  { out.push_back(v); };
+  while (replayer.runOnce(publish))
+    ;
+  EXPECT_EQ(out, (std::vector<int64_t>{1, 2}));
+  EXPECT_FALSE(replayer.done());
+
+  // the writer catches up, the replay picks it up where it stopped
+  a.tryPush(3);
+  b.tryPush(100);
+  EXPECT_TRUE(replayer.runOnce(publish));
+  EXPECT_FALSE(replayer.runOnce(publish));
+  EXPECT_EQ(out, (std::vector<int64_t>{1, 2, 3}));
+  EXPECT_FALSE(replayer.done());
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+#include "exchange-core/SPSCVarQueue.h"
+
+using VarQueue = exchange_core::SPSCVarQueue<4096>;
+
+TEST(SPSCVarQueue, records)
+{
+  auto q = std::make_unique<VarQueue>();
+
+  exchange_core::BBOMessage bbo;
+  exchange_core::TradeMessage trade;
+  exchange_core::JsonMessage json;
+
+  // 64 blocks: BBO and Trade take 2 each, Json takes 16, so the ring wraps with padding several times
+  long seq = 0;
+  long expect = 0;
+  for (int round = 0; round < 50; round++)
+  {
+    bbo.seq = ++seq;
+    bbo.bid_price = seq;
+    ASSERT_TRUE(q->tryPush(bbo));
+    json.seq = ++seq;
+    ASSERT_TRUE(q->tryPush(json));
+    trade.seq = ++seq;
+    ASSERT_TRUE(q->tryPush(trade));
+
+    int cnt = 0;
+    while (q->tryVisitPop([&](const exchange_core::MessageHeader &msg)
+                          {
+                            EXPECT_EQ(msg.seq, ++expect);
+                            if (msg.message_type == exchange_core::MessageType::BBO)
+                            {
+                              EXPECT_EQ(msg.message_size, sizeof(exchange_core::BBOMessage));
+                              EXPECT_EQ(static_cast<const exchange_core::BBOMessage &>(msg).bid_price, msg.seq);
+                            }
+                          }))
+      cnt++;
+    EXPECT_EQ(cnt, 3);
+    EXPECT_TRUE(q->empty());
+  }
+}
+
+TEST(SPSCVarQueue, full)
+{
+  auto q = std::make_unique<VarQueue>();
+
+  // JsonMessage spans 15 blocks and BBOMessage 2 blocks out of 64
+  exchange_core::JsonMessage json;
+  for (int i = 0; i < 4; i++)
+    ASSERT_TRUE(q->tryPush(json));
+  EXPECT_FALSE(q->tryPush(json));
+
+  exchange_core::BBOMessage bbo;
+  EXPECT_TRUE(q->tryPush(bbo));
+  EXPECT_TRUE(q->tryPush(bbo));
+  EXPECT_FALSE(q->tryPush(bbo));
+
+  EXPECT_TRUE(q->tryVisitPop([](const exchange_core::MessageHeader &) {}));
+  for (int i = 0; i < 7; i++)
+    ASSERT_TRUE(q->tryPush(bbo));
+  EXPECT_FALSE(q->tryPush(bbo));
+}
+
+TEST(SPSCVarQueue, partialReservation)
+{
+  auto q = std::make_unique<VarQueue>();
+
+  // reserve room for a Message but only fill a BBOMessage, the reader must land on the next record
+  for (long seq = 1; seq <= 100; seq++)
+  {
+    ASSERT_TRUE(q->tryVisitPush(sizeof(exchange_core::Message), [&](exchange_core::MessageHeader *msg)
+                                {
+                                  auto *bbo = new (msg) exchange_core::BBOMessage();
+                                  bbo->seq = seq;
+                                }));
+    exchange_core::TradeMessage trade;
+    trade.seq = -seq;
+    ASSERT_TRUE(q->tryPush(trade));
+
+    std::vector<long> seqs;
+    while (q->tryVisitPop([&](const exchange_core::MessageHeader &msg)
+                          { seqs.push_back(msg.seq); }))
+      ;
+    EXPECT_EQ(seqs, std::vector<long>({seq, -seq}));
+  }
+}
+
+TEST(SPSCVarQueue, zeroTypeIsNotPadding)
+{
+  auto q = std::make_unique<VarQueue>();
+
+  // a record with message_type 0 is handed out like any other instead of sending the reader to block 0
+  exchange_core::BBOMessage bbo;
+  bbo.message_type = 0;
+  bbo.seq = 1;
+  ASSERT_TRUE(q->tryPush(bbo));
+  bbo.message_type = exchange_core::MessageType::BBO;
+  bbo.seq = 2;
+  ASSERT_TRUE(q->tryPush(bbo));
+
+  std::vector<long> seqs;
+  while (q->tryVisitPop([&](const exchange_core::MessageHeader &msg)
+                        { seqs.push_back(msg.seq); }))
+    ;
+  EXPECT_EQ(seqs, std::vector<long>({1, 2}));
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+
+#include "exchange-core/shm.h"
+
+TEST(shm, numaPlacement)
+{
+  using ShmQueue = exchange_core::WFSPSC<int64_t, 4096>;
+  std::string name = "/exchange_core_test_numa_" + std::to_string(getpid());
+
+  exchange_core::ShmOptions options;
+  options.numaCpu = 0;
+  options.prefault = true;
+  int node = exchange_core::cpuNumaNode(0);
+  ASSERT_GE(node, 0);
+
+  size_t size = 0;
+  auto *q = exchange_core::shmmap<ShmQueue>(name, options, &size);
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(size, sizeof(ShmQueue));
+  auto nodes = exchange_core::numaPageNodes(q);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  EXPECT_EQ(nodes.size(), 1u);
+  EXPECT_EQ(nodes[node], (sizeof(ShmQueue) + pageSize - 1) / pageSize);
+
+  EXPECT_TRUE(exchange_core::shmunmap(q, size));
+  exchange_core::shmremove(name, options);
+}
+
+TEST(shm, reattachResumes)
+{
+  using ShmQueue = exchange_core::WFSPSC<int64_t, 64, 16, exchange_core::OverflowPolicy::FAIL>;
+  std::string name = "/exchange_core_test_reattach_" + std::to_string(getpid());
+
+  auto *q = exchange_core::shmmap<ShmQueue>(name);
+  ASSERT_NE(q, nullptr);
+  for (int64_t i = 1; i <= 10; i++)
+    ASSERT_TRUE(q->tryPush(i));
+  int64_t v;
+  for (int64_t i = 1; i <= 4; i++)
+  {
+    ASSERT_TRUE(q->tryVisitPop([&](int64_t &&x)
+                               { v = x; }));
+    EXPECT_EQ(v, i);
+  }
+  // the consumer "crashes" and remaps the segment
+  exchange_core::shmunmap(q);
+
+  q = exchange_core::shmmap<ShmQueue>(name);
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(q->size(), 6);
+  for (int64_t i = 5; i <= 10; i++)
+  {
+    ASSERT_TRUE(q->tryVisitPop([&](int64_t &&x)
+                               { v = x; }));
+    EXPECT_EQ(v, i);
+  }
+  EXPECT_FALSE(q->tryVisitPop([](int64_t &&) {}));
+
+  exchange_core::shmunmap(q);
+  exchange_core::shmremove(name);
+}
+
+TEST(shm, layoutMismatch)
+{
+  std::string name = "/exchange_core_test_layout_" + std::to_string(getpid());
+
+  auto *q = exchange_core::shmmap<exchange_core::WFSPSC<int64_t, 64>>(name);
+  ASSERT_NE(q, nullptr);
+  exchange_core::shmunmap(q);
+
+  // different size: rejected before the segment is resized
+  using BiggerQueue = exchange_core::WFSPSC<int64_t, 128>;
+  EXPECT_EQ(exchange_core::shmmap<BiggerQueue>(name), nullptr);
+  // same size, different element size: rejected by the header
+  using NarrowQueue = exchange_core::WFSPSC<int32_t, 128>;
+  ASSERT_EQ(sizeof(NarrowQueue), sizeof(*q));
+  EXPECT_EQ(exchange_core::shmmap<NarrowQueue>(name), nullptr);
+
+  exchange_core::shmremove(name);
+}
+
+TEST(shm, cursorPersists)
+{
+  using ShmQueue = exchange_core::WFSPMC<int64_t, 64>;
+  std::string name = "/exchange_core_test_cursor_" + std::to_string(getpid());
+
+  auto *q = exchange_core::shmmap<ShmQueue>(name);
+  ASSERT_NE(q, nullptr);
+  int id = q->openCursor("reader");
+  ASSERT_GE(id, 0);
+  EXPECT_EQ(q->getCursor(id), 1);
+  for (int64_t i = 1; i <= 10; i++)
+    q->emplace(i * 100);
+  int64_t v;
+  for (int64_t idx = q->getCursor(id); idx <= 3; idx++)
+  {
+    ASSERT_EQ(q->tryRead(v, idx), exchange_core::ReadResult::OK);
+    EXPECT_EQ(v, idx * 100);
+    q->commitCursor(id, idx + 1);
+  }
+  exchange_core::shmunmap(q);
+
+  q = exchange_core::shmmap<ShmQueue>(name);
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(q->openCursor("reader"), id);
+  EXPECT_EQ(q->getCursor(id), 4);
+  ASSERT_EQ(q->tryRead(v, q->getCursor(id)), exchange_core::ReadResult::OK);
+  EXPECT_EQ(v, 400);
+
+  // a new reader starts at the next message to be published
+  int other = q->openCursor("late");
+  EXPECT_NE(other, id);
+  EXPECT_EQ(q->getCursor(other), 11);
+  q->closeCursor(other);
+
+  exchange_core::shmunmap(q);
+  exchange_core::shmremove(name);
+}
+
+TEST(shm, hugePagesUnmap)
+{
+  using ShmQueue = exchange_core::WFSPSC<int64_t, 4096>;
+  std::string name = "/exchange_core_test_huge_" + std::to_string(getpid());
+
+  // maps whole huge pages where /dev/hugepages has some, regular shm otherwise; either way the reported
+  // length undoes it
+  exchange_core::ShmOptions options;
+  options.hugePages = true;
+  for (int i = 0; i < 2; i++)
+  {
+    size_t size = 0;
+    auto *q = exchange_core::shmmap<ShmQueue>(name, options, &size);
+    ASSERT_NE(q, nullptr);
+    EXPECT_GE(size, sizeof(ShmQueue));
+    q->emplace(i);
+    EXPECT_TRUE(exchange_core::shmunmap(q, size));
+  }
+  exchange_core::shmremove(name, options);
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/wait.h>
+
+#include "exchange-core/TopicRegistry.h"
+
+TEST(topicRegistry, publishSubscribe)
+{
+  std::string suffix = std::to_string(getpid());
+  std::string name = "/exchange_core_test_topics_" + suffix;
+  auto *registry = exchange_core::getTopicRegistry(name);
+  ASSERT_NE(registry, nullptr);
+
+  std::vector<std::string> topics = {"md." + suffix + ".phemex.BTCUSD", "md." + suffix + ".phemex.ETHUSD",
+                                     "md." + suffix + ".binance.BTCUSDT"};
+  std::vector<exchange_core::TopicQueue *> queues;
+  for (auto &topic : topics)
+  {
+    queues.push_back(exchange_core::publishTopic(*registry, topic));
+    ASSERT_NE(queues.back(), nullptr);
+  }
+  queues[1]->emplace();
+
+  auto matches = registry->match("md." + suffix + ".phemex.*");
+  ASSERT_EQ(matches.size(), 2u);
+  for (auto *entry : matches)
+  {
+    EXPECT_TRUE(entry->alive());
+    EXPECT_EQ(entry->producer_pid, getpid());
+    EXPECT_STREQ(entry->type, "WFSPMC");
+    EXPECT_EQ(entry->elem_size, sizeof(exchange_core::Message));
+  }
+
+  auto *entry = registry->find(topics[1]);
+  ASSERT_NE(entry, nullptr);
+  auto *q = exchange_core::subscribeTopic(*entry);
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(q->getCurrentWriteIdx(), 1);
+  EXPECT_EQ(registry->find("md." + suffix + ".phemex.XRPUSD"), nullptr);
+
+  // same topic, other queue layout
+  using OtherQueue = exchange_core::WFSPMC<exchange_core::Message, 2048>;
+  EXPECT_EQ(exchange_core::publishTopic<OtherQueue>(*registry, topics[0]), nullptr);
+
+  exchange_core::shmunmap(q);
+  for (size_t i = 0; i < topics.size(); i++)
+  {
+    exchange_core::shmunmap(queues[i]);
+    exchange_core::removeTopic(*registry->find(topics[i]));
+  }
+  exchange_core::shmunmap(registry);
+  exchange_core::shmremove(name);
+}
+
+TEST(topicRegistry, deadProducer)
+{
+  std::string name = "/exchange_core_test_topics_dead_" + std::to_string(getpid());
+  std::string topic = "dead." + std::to_string(getpid());
+  auto *registry = exchange_core::getTopicRegistry(name);
+  ASSERT_NE(registry, nullptr);
+
+  pid_t pid = fork();
+  if (pid == 0)
+    _exit(exchange_core::publishTopic(*registry, topic) ? 0 : 1);
+  int status;
+  waitpid(pid, &status, 0);
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  auto *entry = registry->find(topic);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->producer_pid, pid);
+  EXPECT_FALSE(entry->alive());
+
+  // a restarted producer takes the topic over
+  auto *q = exchange_core::publishTopic(*registry, topic);
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(registry->find(topic), entry);
+  EXPECT_TRUE(entry->alive());
+
+  exchange_core::shmunmap(q);
+  exchange_core::removeTopic(*entry);
+  exchange_core::shmunmap(registry);
+  exchange_core::shmremove(name);
+}
+
+TEST(topicRegistry, liveProducer)
+{
+  std::string name = "/exchange_core_test_topics_live_" + std::to_string(getpid());
+  std::string topic = "live." + std::to_string(getpid());
+  auto *registry = exchange_core::getTopicRegistry(name);
+  ASSERT_NE(registry, nullptr);
+
+  // the child publishes, tells the parent and keeps producing until the parent closes the pipe
+  int ready[2], done[2];
+  ASSERT_EQ(pipe(ready), 0);
+  ASSERT_EQ(pipe(done), 0);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    close(done[1]);
+    char c = exchange_core::publishTopic(*registry, topic) ? 1 : 0;
+    write(ready[1], &c, 1);
+    read(done[0], &c, 1);
+    _exit(0);
+  }
+  char c = 0;
+  ASSERT_EQ(read(ready[0], &c, 1), 1);
+  ASSERT_EQ(c, 1);
+
+  // a second producer must not share the single producer queue
+  EXPECT_EQ(exchange_core::publishTopic(*registry, topic), nullptr);
+  auto *entry = registry->find(topic);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->producer_pid, pid);
+
+  close(done[1]);
+  waitpid(pid, nullptr, 0);
+  auto *q = exchange_core::publishTopic(*registry, topic);
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(entry->producer_pid, getpid());
+
+  close(ready[0]);
+  close(ready[1]);
+  close(done[0]);
+  exchange_core::shmunmap(q);
+  exchange_core::removeTopic(*entry);
+  exchange_core::shmunmap(registry);
+  exchange_core::shmremove(name);
+}
+
+TEST(topicRegistry, abandonedClaim)
+{
+  std::string name = "/exchange_core_test_topics_claim_" + std::to_string(getpid());
+  // long enough that the segment name is longer than the topic name field
+  std::string topic = "claim." + std::to_string(getpid());
+  topic.resize(63, 'x');
+  auto *registry = exchange_core::getTopicRegistry(name);
+  ASSERT_NE(registry, nullptr);
+
+  auto *q = exchange_core::publishTopic(*registry, topic);
+  ASSERT_NE(q, nullptr);
+  auto *entry = const_cast<exchange_core::TopicEntry *>(registry->find(topic));
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(std::string(entry->segment), exchange_core::TopicRegistry::segmentName(topic));
+  exchange_core::shmunmap(q);
+
+  // as left by a process that died while claiming the entry
+  pid_t pid = fork();
+  if (pid == 0)
+    _exit(0);
+  waitpid(pid, nullptr, 0);
+  entry->producer_pid = pid;
+  entry->state = exchange_core::TopicEntry::CLAIMED;
+
+  EXPECT_EQ(registry->find(topic), nullptr);
+  q = exchange_core::publishTopic(*registry, topic);
+  ASSERT_NE(q, nullptr);
+  EXPECT_EQ(registry->find(topic), entry);
+  EXPECT_TRUE(entry->alive());
+
+  exchange_core::shmunmap(q);
+  exchange_core::removeTopic(*entry);
+  exchange_core::shmunmap(registry);
+  exchange_core::shmremove(name);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+
+#include "exchange-core/WFMPMC.h"
+
+using MPMC = exchange_core::WFMPMC<int64_t, 64, 4>;
+
+TEST(WFMPMC, handles)
+{
+  auto q = std::make_unique<MPMC>();
+
+  MPMC::Handle *handles[4];
+  for (auto &h : handles)
+    ASSERT_NE(h = q->registerHandle(), nullptr);
+  EXPECT_EQ(q->registerHandle(), nullptr);
+
+  // a pop on an empty queue keeps its index, so the handle can't be released until it is retried
+  int64_t v = 0;
+  EXPECT_FALSE(q->tryPop(handles[0], v));
+  EXPECT_FALSE(q->unregisterHandle(handles[0]));
+  EXPECT_TRUE(q->tryPush(handles[1], int64_t(42)));
+  EXPECT_TRUE(q->tryPop(handles[0], v));
+  EXPECT_EQ(v, 42);
+
+  for (auto h : handles)
+    EXPECT_TRUE(q->unregisterHandle(h));
+  EXPECT_NE(q->registerHandle(), nullptr);
+}
+
+TEST(WFMPMC, recycledSlots)
+{
+  auto q = std::make_unique<MPMC>();
+  auto *consumer = q->registerHandle();
+
+  // far more short-lived workers than THR_SIZE, both with handles and with the implicit per-thread slot
+  int64_t sum = 0;
+  int64_t expect = 0;
+  for (int64_t i = 1; i <= 32; i++)
+  {
+    std::thread worker([&]
+                       {
+                         if (i % 2)
+                         {
+                           auto *h = q->registerHandle();
+                           ASSERT_NE(h, nullptr);
+                           for (int64_t j = 0; j < 10; j++)
+                             EXPECT_TRUE(q->tryPush(h, i));
+                           EXPECT_TRUE(q->unregisterHandle(h));
+                         }
+                         else
+                         {
+                           for (int64_t j = 0; j < 10; j++)
+                             EXPECT_TRUE(q->tryPush(i));
+                           EXPECT_TRUE(q->unregisterThread());
+                         }
+                       });
+    worker.join();
+    expect += 10 * i;
+    int64_t v;
+    while (q->tryPop(consumer, v))
+      sum += v;
+  }
+  EXPECT_EQ(sum, expect);
+}
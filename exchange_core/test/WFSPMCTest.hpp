@@ -0,0 +1,41 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <memory>
+
+#include "exchange-core/WFSPMC.h"
+
+using SPMC = exchange_core::WFSPMC<int64_t, 16>;
+
+TEST(WFSPMC, lapDetection)
+{
+  auto q = std::make_unique<SPMC>();
+  int64_t v = 0;
+
+  EXPECT_EQ(q->tryRead(v, 1), exchange_core::ReadResult::NOT_READY);
+  for (int64_t i = 1; i <= 20; i++)
+    q->tryPush(i);
+
+  // the reader at 1 has been lapped by 4 messages
+  EXPECT_EQ(q->tryRead(v, 1), exchange_core::ReadResult::LAPPED);
+  EXPECT_EQ(q->tryVisitPop([&](int64_t &&val) { v = val; }, 1), exchange_core::ReadResult::LAPPED);
+  EXPECT_EQ(q->getLag(1), 20);
+  EXPECT_EQ(q->getOldestIdx(), 5);
+
+  int64_t idx = q->getOldestIdx();
+  for (; idx <= 20; idx++)
+  {
+    ASSERT_EQ(q->tryRead(v, idx), exchange_core::ReadResult::OK);
+    EXPECT_EQ(v, idx);
+  }
+  EXPECT_EQ(q->tryRead(v, idx), exchange_core::ReadResult::NOT_READY);
+  EXPECT_EQ(q->tryVisitPop([&](int64_t &&val) { v = val; }, 20), exchange_core::ReadResult::OK);
+  EXPECT_EQ(v, 20);
+  EXPECT_EQ(q->tryVisitPop([&](int64_t &&val) { v = val; }, 21), exchange_core::ReadResult::NOT_READY);
+
+  // a slot the producer has started to overwrite is reported as lapped, not handed out half-written
+  q->getWritable(5 + 16);
+  EXPECT_EQ(q->tryRead(v, 5), exchange_core::ReadResult::LAPPED);
+  EXPECT_EQ(q->tryRead(v, 21), exchange_core::ReadResult::NOT_READY);
+  q->commitWrite(21);
+  EXPECT_EQ(q->tryRead(v, 21), exchange_core::ReadResult::OK);
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+
+#include "exchange-core/WFSPSC.h"
+
+using SPSC = exchange_core::WFSPSC<int64_t, 16>;
+
+TEST(WFSPSC, batch)
+{
+  auto q = std::make_unique<SPSC>();
+
+  int64_t next = 0;
+  auto written = q->tryVisitPushBatch([&](int64_t *vals, uint32_t cnt)
+                                      {
+                                        for (uint32_t i = 0; i < cnt; i++)
+                                          vals[i] = ++next;
+                                      },
+                                      10);
+  EXPECT_EQ(written, 10u);
+  EXPECT_EQ(q->size(), 10);
+
+  int64_t expect = 0;
+  auto reader = [&](int64_t *vals, uint32_t cnt)
+  {
+    for (uint32_t i = 0; i < cnt; i++)
+      EXPECT_EQ(vals[i], ++expect);
+  };
+  EXPECT_EQ(q->tryVisitPopBatch(reader, 4), 4u);
+  EXPECT_EQ(q->tryVisitPopBatch(reader, 64), 6u);
+  EXPECT_EQ(q->tryVisitPopBatch(reader, 64), 0u);
+  EXPECT_TRUE(q->empty());
+
+  // the next batch wraps around the end of the ring and is visited in two pieces
+  int calls = 0;
+  written = q->tryVisitPushBatch([&](int64_t *vals, uint32_t cnt)
+                                 {
+                                   calls++;
+                                   for (uint32_t i = 0; i < cnt; i++)
+                                     vals[i] = ++next;
+                                 },
+                                 12);
+  EXPECT_EQ(written, 12u);
+  EXPECT_EQ(calls, 2);
+  EXPECT_EQ(q->tryVisitPopBatch(reader, 64), 12u);
+  EXPECT_EQ(expect, next);
+
+  // single element and batch api interleave
+  q->tryPush(++next);
+  EXPECT_EQ(q->tryVisitPopBatch(reader, 1), 1u);
+  EXPECT_EQ(expect, next);
+}
+
+TEST(WFSPSC, boundedFail)
+{
+  using Queue = exchange_core::WFSPSC<int64_t, 16, 16, exchange_core::OverflowPolicy::FAIL>;
+  auto q = std::make_unique<Queue>();
+
+  int64_t v = 0;
+  EXPECT_FALSE(q->tryVisitPop([&](int64_t &&val) { v = val; }));
+  for (int64_t i = 1; i <= 16; i++)
+    EXPECT_TRUE(q->tryPush(i));
+  EXPECT_FALSE(q->tryPush(17));
+
+  EXPECT_TRUE(q->tryVisitPop([&](int64_t &&val) { v = val; }));
+  EXPECT_EQ(v, 1);
+  EXPECT_TRUE(q->tryPush(17));
+
+  // only the free slots are claimed by a batch
+  q->tryVisitPop([&](int64_t &&val) { v = val; });
+  q->tryVisitPop([&](int64_t &&val) { v = val; });
+  int64_t next = 17;
+  auto written = q->tryVisitPushBatch([&](int64_t *vals, uint32_t cnt)
+                                      {
+                                        for (uint32_t i = 0; i < cnt; i++)
+                                          vals[i] = ++next;
+                                      },
+                                      8);
+  EXPECT_EQ(written, 2u);
+  EXPECT_EQ(q->size(), 16);
+
+  int64_t expect = 3;
+  while (q->tryVisitPop([&](int64_t &&val) { EXPECT_EQ(val, ++expect); }))
+    ;
+  EXPECT_EQ(expect, 19);
+  EXPECT_EQ(q->getDroppedCount(), 0);
+}
+
+TEST(WFSPSC, boundedDropOldest)
+{
+  using Queue = exchange_core::WFSPSC<int64_t, 16, 16, exchange_core::OverflowPolicy::DROP_OLDEST>;
+  auto q = std::make_unique<Queue>();
+
+  for (int64_t i = 1; i <= 20; i++)
+    EXPECT_TRUE(q->tryPush(i));
+  EXPECT_EQ(q->getDroppedCount(), 4);
+  EXPECT_EQ(q->pop(), 5);
+
+  int64_t expect = 5;
+  auto n = q->tryVisitPopBatch([&](int64_t *vals, uint32_t cnt)
+                               {
+                                 for (uint32_t i = 0; i < cnt; i++)
+                                   EXPECT_EQ(vals[i], ++expect);
+                               },
+                               64);
+  EXPECT_EQ(n, 15u);
+  EXPECT_EQ(expect, 20);
+}
+
+TEST(WFSPSC, boundedSpin)
+{
+  using Queue = exchange_core::WFSPSC<int64_t, 16, 16, exchange_core::OverflowPolicy::SPIN>;
+  auto q = std::make_unique<Queue>();
+  const int64_t count = 2000;
+
+  std::thread producer([&]
+                       {
+                         for (int64_t i = 1; i <= count; i++)
+                           q->emplace(i);
+                       });
+  for (int64_t i = 1; i <= count; i++)
+    ASSERT_EQ(q->pop(), i);
+  producer.join();
+  EXPECT_EQ(q->getDroppedCount(), 0);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "exchange-core/WFSPSC.h"
+#include "exchange-core/WFSPMC.h"
+#include "exchange-core/WFMPMC.h"
+
+template <class Wait, class Notify = exchange_core::NoNotify>
+void testSPSCWait()
+{
+  auto q = std::make_unique<exchange_core::WFSPSC<int64_t, 16, 16, exchange_core::OverflowPolicy::SPIN, Notify>>();
+  const int64_t count = 200;
+
+  std::thread producer([&]
+                       {
+                         for (int64_t i = 1; i <= count; i++)
+                         {
+                           if (i % 50 == 0)
+                             std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                           q->emplace(i);
+                         }
+                       });
+  for (int64_t i = 1; i <= count; i++)
+  {
+    int64_t v = 0;
+    q->template waitVisitPop<Wait>([&](int64_t &&val) { v = val; });
+    ASSERT_EQ(v, i);
+  }
+  producer.join();
+}
+
+TEST(WaitStrategy, spsc)
+{
+  testSPSCWait<exchange_core::BusySpinWait>();
+  testSPSCWait<exchange_core::PauseWait>();
+  testSPSCWait<exchange_core::YieldWait>();
+  testSPSCWait<exchange_core::FutexWait<10>, exchange_core::ShmNotifier>();
+}
+
+TEST(WaitStrategy, futexWakeup)
+{
+  auto spmc = std::make_unique<exchange_core::WFSPMC<int64_t, 16, 16, exchange_core::ShmNotifier>>();
+  auto mpmc = std::make_unique<exchange_core::WFMPMC<int64_t, 16, 16, exchange_core::ShmNotifier>>();
+
+  std::thread producer([&]
+                       {
+                         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                         spmc->tryPush(int64_t(7));
+                         mpmc->emplace(int64_t(8));
+                       });
+  int64_t v = 0;
+  EXPECT_EQ(spmc->waitRead(v, 1, exchange_core::FutexWait<10>()), exchange_core::ReadResult::OK);
+  EXPECT_EQ(v, 7);
+  mpmc->waitVisitPop<exchange_core::FutexWait<10>>([&](int64_t &&val) { v = val; });
+  EXPECT_EQ(v, 8);
+  producer.join();
+}
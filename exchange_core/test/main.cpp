@@ -0,0 +1,25 @@
+#include <gtest/gtest.h>
+#include "WFSPSCTest.hpp"
+#include "WFSPMCTest.hpp"
+#include "SPSCVarQueueTest.hpp"
+#include "WaitStrategyTest.hpp"
+#include "ShmTest.hpp"
+#include "WFMPMCTest.hpp"
+#include "TopicRegistryTest.hpp"
+#include "JournalTest.hpp"
+#include "ReplayTest.hpp"
+#include "BridgeTest.hpp"
+#include "MessageTest.hpp"
+#include "BookBuilderTest.hpp"
+#include "MessageDispatcherTest.hpp"
+#include "OrderBookTest.hpp"
+#include "PriceTest.hpp"
+#include "ClockTest.hpp"
+#include "ListenerChainTest.hpp"
+#include "PriceLadderTest.hpp"
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,54 @@
+// Fans a MulticastQueue out to other hosts
+// usage: bridge pub <queue> <group> <port> <retransmit port> [iface]
+//        bridge sub <queue> <group> <port> <publisher> <retransmit port> [start seq] [iface]
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#include "exchange-core/shm.h"
+#include "exchange-core/Bridge.h"
+
+using namespace exchange_core;
+
+static volatile std::sig_atomic_t running = 1;
+
+int main(int argc, char *argv[])
+{
+  std::string mode = argc > 1 ? argv[1] : "";
+  if (!((mode == "pub" && argc >= 6 && argc <= 7) || (mode == "sub" && argc >= 7 && argc <= 9)))
+  {
+    std::cerr << "usage: " << argv[0] << " pub <queue> <group> <port> <retransmit port> [iface]" << std::endl
+              << "       " << argv[0] << " sub <queue> <group> <port> <publisher> <retransmit port> [start seq] [iface]" << std::endl;
+    return 1;
+  }
+  std::signal(SIGINT, [](int)
+              { running = 0; });
+  std::signal(SIGTERM, [](int)
+              { running = 0; });
+
+  MulticastQueue *q = getMulticastQueue(argv[2]);
+  if (!q)
+    return 1;
+  if (mode == "pub")
+  {
+    BridgePublisher<MulticastQueue> publisher;
+    if (!publisher.open(q, argv[3], atoi(argv[4]), atoi(argv[5]), argc > 6 ? argv[6] : "0.0.0.0"))
+      return 1;
+    while (running)
+      if (!publisher.runOnce())
+        cpuRelax();
+    std::cerr << "lost " << publisher.getLostCount() << " messages" << std::endl;
+  }
+  else
+  {
+    BridgeReceiver<MulticastQueue> receiver;
+    if (!receiver.open(q, argv[3], atoi(argv[4]), argv[5], atoi(argv[6]), argc > 7 ? atol(argv[7]) : 0,
+                       argc > 8 ? argv[8] : "0.0.0.0"))
+      return 1;
+    while (running)
+      if (!receiver.runOnce())
+        cpuRelax();
+    std::cerr << receiver.getGapCount() << " gaps, lost " << receiver.getLostCount() << " messages" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+// Persists every message published into a MulticastQueue into a journal
+// usage: journal_capture <queue> <dir> <journal>
+#include <csignal>
+#include <iostream>
+
+#include "exchange-core/shm.h"
+#include "exchange-core/Journal.h"
+
+using namespace exchange_core;
+
+static volatile std::sig_atomic_t running = 1;
+
+int main(int argc, char *argv[])
+{
+  if (argc != 4)
+  {
+    std::cerr << "usage: " << argv[0] << " <queue> <dir> <journal>" << std::endl;
+    return 1;
+  }
+  std::signal(SIGINT, [](int)
+              { running = 0; });
+  std::signal(SIGTERM, [](int)
+              { running = 0; });
+
+  MulticastQueue *q = getMulticastQueue(argv[1]);
+  JournalWriter<Message> journal;
+  if (!q || !journal.open(argv[2], argv[3]))
+    return 1;
+
+  int64_t idx = q->getCurrentWriteIdx() + 1;
+  int64_t lost = 0;
+  while (running)
+  {
+    Message *data = journal.getWritable(journal.getCurrentWriteIdx() + 1);
+    if (!data)
+      return 1;
+    // copy straight into the journal slot, only the bytes the message uses; a lapped copy is never committed
+    ReadResult res = q->tryVisitPop([&](Message &&msg)
+                                    { memcpy(data, &msg, std::min<size_t>(msg.message_size, sizeof(Message))); },
+                                    idx);
+
+    if (res == ReadResult::OK)
+    {
+      journal.commitWrite(journal.getCurrentWriteIdx() + 1);
+      idx++;
+    }
+    else if (res == ReadResult::LAPPED)
+    {
+      // idx itself is gone even if the producer hasn't moved write_idx past it yet
+      int64_t oldest = std::max(idx + 1, q->getOldestIdx());
+      lost += oldest - idx;
+      std::cerr << "capture lapped, " << lost << " messages lost so far" << std::endl;
+      idx = oldest;
+    }
+    else
+    {
+      journal.maintain();
+      cpuRelax();
+    }
+  }
+  return 0;
+}
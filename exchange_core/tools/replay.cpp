@@ -0,0 +1,58 @@
+// Replays captured journals into a MulticastQueue, merged on capture time
+// usage: replay [-s speed] [-f] <queue> <dir>/<journal>...
+// speed 1 (default) replays at wall-clock speed, N at N times it, 0 as fast as possible
+// -f keeps tailing journals that are still being written instead of stopping at their end
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "exchange-core/shm.h"
+#include "exchange-core/Replay.h"
+
+using namespace exchange_core;
+
+int main(int argc, char *argv[])
+{
+  double speed = 1;
+  bool follow = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:f")) != -1)
+  {
+    if (opt == 's')
+      speed = atof(optarg);
+    else if (opt == 'f')
+      follow = true;
+    else
+    {
+      std::cerr << "usage: " << argv[0] << " [-s speed] [-f] <queue> <dir>/<journal>..." << std::endl;
+      return 1;
+    }
+  }
+  if (argc - optind < 2 || speed < 0)
+  {
+    std::cerr << "usage: " << argv[0] << " [-s speed] [-f] <queue> <dir>/<journal>..." << std::endl;
+    return 1;
+  }
+
+  MulticastQueue *q = getMulticastQueue(argv[optind]);
+  if (!q)
+    return 1;
+  Replayer<Message> replayer(speed);
+  for (int i = optind + 1; i < argc; i++)
+  {
+    std::string path = argv[i];
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    if (!replayer.add(dir, path.substr(slash + 1), 1, follow))
+    {
+      std::cerr << "can't open journal " << path << std::endl;
+      return 1;
+    }
+  }
+  auto start = std::chrono::steady_clock::now();
+  int64_t cnt = replayer.run(publishTo(*q));
+  std::cerr << "replayed " << cnt << " messages in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()
+            << " ms" << std::endl;
+  return 0;
+}
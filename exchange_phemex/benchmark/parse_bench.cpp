@@ -0,0 +1,140 @@
+// Messages per second through the Phemex market data parse path: a fresh Document with a copying Parse and
+// std::string fields per frame, as MarketDataService did, vs the in-situ pooled parse, vs the FrameScanner, and the
+// whole MarketDataService::onMessage, which scans and falls back to the in-situ parse
+// usage: parse_bench [recorded_feed] [repeat]
+// recorded_feed holds one websocket frame per line, e.g. the "WebSocket message" debug log stripped of its prefix;
+// without one, a synthetic BTCUSD book and trade stream is used
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "exchange-phemex/MarketDataService.hpp"
+
+namespace
+{
+  std::vector<std::string> syntheticFeed(size_t n)
+  {
+    std::mt19937_64 rng(7);
+    std::vector<std::string> ret;
+    int64_t mid = 400000000;
+    char buf[512];
+    for (size_t i = 0; i < n; i++)
+    {
+      mid += exchange_phemex::BTCUSD_TICK_EP * ((int64_t)(rng() % 3) - 1);
+      long ts = 1590196000000000000 + i * 1000000;
+      if (i == 0 || rng() % 8)
+      {
+        int64_t bid = mid - exchange_phemex::BTCUSD_TICK_EP * (1 + rng() % 20);
+        int64_t ask = mid + exchange_phemex::BTCUSD_TICK_EP * (1 + rng() % 20);
+        snprintf(buf, sizeof(buf),
+                 R"({"book":{"asks":[[%ld,%ld]],"bids":[[%ld,%ld],[%ld,0]]},"depth":30,"sequence":%zu,"symbol":"BTCUSD","timestamp":%ld,"type":"%s"})",
+                 ask, rng() % 100000, bid, rng() % 100000, bid - exchange_phemex::BTCUSD_TICK_EP, i, ts, i ? "incremental" : "snapshot");
+      }
+      else
+        snprintf(buf, sizeof(buf), R"({"sequence":%zu,"symbol":"BTCUSD","trades":[[%ld,"%s",%ld,%ld]],"type":"incremental"})",
+                 i, ts, rng() & 1 ? "Buy" : "Sell", mid, rng() % 1000 + 1);
+      ret.push_back(buf);
+    }
+    return ret;
+  }
+
+  struct NullListener
+  {
+    void onOrderBook(const exchange_core::OrderBook &book) { sum += book.bids.size(); }
+    void onTrade(const exchange_core::FeedTrade &trade) { sum += trade.quantity.raw(); }
+    int64_t sum = 0;
+  };
+
+  int64_t legacyParse(const std::string &msg)
+  {
+    rapidjson::Document doc;
+    doc.Parse(msg.c_str());
+    int64_t sum = 0;
+    if (doc.HasMember("book") || doc.HasMember("trades"))
+    {
+      std::string type = doc["type"].GetString();
+      std::string symbol = doc["symbol"].GetString();
+      sum += type.size() + symbol.size();
+    }
+    return sum;
+  }
+
+  int64_t insituParse(exchange_phemex::InsituDocument &doc, rapidjson::MemoryPoolAllocator<> &values,
+                      rapidjson::MemoryPoolAllocator<> &stack, char *data)
+  {
+    doc.SetNull();
+    values.Clear();
+    stack.Clear();
+    doc.ParseInsitu(data);
+    auto type = doc.FindMember("type");
+    auto symbol = doc.FindMember("symbol");
+    return type != doc.MemberEnd() && symbol != doc.MemberEnd() ? type->value.GetStringLength() + symbol->value.GetStringLength() : 0;
+  }
+
+  template <class F>
+  void run(const char *config, const std::vector<std::string> &feed, int repeat, F f)
+  {
+    int64_t check = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
+      for (auto &msg : feed)
+        check += f(msg);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s,%.0f\n", config, feed.size() * repeat / secs);
+    fprintf(stderr, "%s check %ld\n", config, check);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::string> feed;
+  if (argc > 1)
+  {
+    std::ifstream in(argv[1]);
+    for (std::string line; std::getline(in, line);)
+      if (!line.empty())
+        feed.push_back(line);
+  }
+  else
+    feed = syntheticFeed(100000);
+  int repeat = argc > 2 ? atoi(argv[2]) : 20;
+  spdlog::set_level(spdlog::level::info);
+
+  // the in-situ runs parse a copy in a reused buffer, as the session's read buffer is
+  std::vector<char> frame;
+  auto copy = [&](const std::string &msg)
+  {
+    frame.assign(msg.begin(), msg.end());
+    frame.push_back(0);
+    return frame.data();
+  };
+
+  static char valueBuffer[64 * 1024], stackBuffer[16 * 1024];
+  rapidjson::MemoryPoolAllocator<> values(valueBuffer, sizeof(valueBuffer));
+  rapidjson::MemoryPoolAllocator<> stack(stackBuffer, sizeof(stackBuffer));
+  exchange_phemex::InsituDocument doc(&values, 1024, &stack);
+  auto service = std::make_unique<exchange_phemex::BasicMarketDataService<NullListener>>();
+  exchange_core::Instrument btcusd;
+  btcusd.symbol = "BTCUSD";
+  btcusd.instrument_id = 1;
+  btcusd.price_scale = exchange_phemex::PRICE_EP_SCALE;
+  btcusd.tick_size = exchange_phemex::BTCUSD_TICK_EP;
+  service->Subscribe(btcusd);
+
+  printf("parse,msgs_per_sec\n");
+  run("document_per_frame", feed, repeat, legacyParse);
+  run("insitu_pooled", feed, repeat, [&](const std::string &msg)
+      { return insituParse(doc, values, stack, copy(msg)); });
+  exchange_phemex::FrameScanner scanner;
+  run("frame_scanner", feed, repeat, [&](const std::string &msg)
+      { return scanner.scan(msg.data(), msg.size()) ? (int64_t)(scanner.getBids().size() + scanner.getTrades().size()) : 0; });
+  run("service_onMessage", feed, repeat, [&](const std::string &msg)
+      {
+        service->onMessage(copy(msg), msg.size());
+        return service->getListener().sum; });
+  return 0;
+}
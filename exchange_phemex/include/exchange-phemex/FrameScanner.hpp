@@ -0,0 +1,274 @@
+#pragma once
+#include <exchange-core/exchange-core.h>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace exchange_phemex
+{
+  // first c in [p, end), end if none; 16 bytes per step with SSE2
+  inline const char *findChar(const char *p, const char *end, char c)
+  {
+#if defined(__SSE2__)
+    __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16)
+    {
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), needle));
+      if (mask)
+        return p + __builtin_ctz(mask);
+    }
+#endif
+    while (p < end && *p != c)
+      p++;
+    return p;
+  }
+
+  // Value of the run of up to 8 digits at p, 8 bytes of which must be readable, in a handful of multiplies
+  // len gets the number of digits
+  inline uint64_t parseDigits8(const char *p, int &len)
+  {
+    uint64_t x;
+    memcpy(&x, p, 8);
+    uint64_t t = x - 0x3030303030303030ull;
+    // high bit of every byte that's not '0'..'9'; borrows and carries only reach bytes past the first non-digit
+    uint64_t nondigit = (t | (t + 0x7676767676767676ull)) & 0x8080808080808080ull;
+    len = nondigit ? __builtin_ctzll(nondigit) / 8 : 8;
+    if (!len)
+      return 0;
+    // drop what follows the digits, the shifted in zero bytes are leading zeros
+    t <<= (8 - len) * 8;
+    t = (t & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+    t = (t & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return (t & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32;
+  }
+
+  // Streaming decoder for the two hot Phemex market data frames, without a DOM:
+  //   {"book":{"asks":[[priceEp,qty],...],"bids":[...]},"depth":30,"sequence":N,"symbol":"BTCUSD","timestamp":T,"type":"incremental"}
+  //   {"sequence":N,"symbol":"BTCUSD","trades":[[T,"Buy",priceEp,qty],...],"type":"incremental"}
+  // Quotes are located with SSE2 and integers are converted 8 digits at a time. scan() returns false for anything
+  // else, escapes, unknown keys, non-integer numbers or more levels than fit, so the caller can fall back to a
+  // generic parser; the frame is never modified
+  class FrameScanner
+  {
+  public:
+    static constexpr size_t MAX_LEVELS = 128;
+    static constexpr size_t MAX_TRADES = 64;
+
+    struct Level
+    {
+      int64_t price;
+      int64_t quantity;
+    };
+
+    struct Trade
+    {
+      int64_t timestamp;
+      exchange_core::Side side;
+      int64_t price;
+      int64_t quantity;
+    };
+
+    bool scan(const char *data, size_t size)
+    {
+      p = data;
+      end = data + size;
+      bids.clear();
+      asks.clear();
+      trades.clear();
+      symbol = type = std::string_view();
+      timestamp = 0;
+      book = has_trades = false;
+      // let the generic parser unescape
+      if (findChar(data, end, '\\') != end || !consume('{'))
+        return false;
+      do
+      {
+        std::string_view key;
+        int64_t ignored;
+        if (!string(key) || !consume(':'))
+          return false;
+        bool ok;
+        if (key == "book")
+          ok = book = levelBook();
+        else if (key == "trades")
+          ok = has_trades = tradeList();
+        else if (key == "symbol")
+          ok = string(symbol);
+        else if (key == "type")
+          ok = string(type);
+        else if (key == "timestamp")
+          ok = integer(timestamp);
+        else if (key == "sequence" || key == "depth")
+          ok = integer(ignored);
+        else
+          ok = false;
+        if (!ok)
+          return false;
+      } while (consume(','));
+      return consume('}') && book != has_trades && !symbol.empty() && !type.empty();
+    }
+
+    // a book frame, otherwise a trades frame
+    bool isBook() const
+    {
+      return book;
+    }
+
+    std::string_view getSymbol() const
+    {
+      return symbol;
+    }
+
+    std::string_view getType() const
+    {
+      return type;
+    }
+
+    // ns since epoch, 0 for trades frames
+    int64_t getTimestamp() const
+    {
+      return timestamp;
+    }
+
+    const exchange_core::FixedVector<Level, MAX_LEVELS> &getBids() const
+    {
+      return bids;
+    }
+
+    const exchange_core::FixedVector<Level, MAX_LEVELS> &getAsks() const
+    {
+      return asks;
+    }
+
+    const exchange_core::FixedVector<Trade, MAX_TRADES> &getTrades() const
+    {
+      return trades;
+    }
+
+  private:
+    void skipSpace()
+    {
+      while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+        p++;
+    }
+
+    bool consume(char c)
+    {
+      skipSpace();
+      if (p == end || *p != c)
+        return false;
+      p++;
+      return true;
+    }
+
+    bool string(std::string_view &out)
+    {
+      if (!consume('"'))
+        return false;
+      const char *q = findChar(p, end, '"');
+      if (q == end)
+        return false;
+      out = std::string_view(p, q - p);
+      p = q + 1;
+      return true;
+    }
+
+    bool integer(int64_t &out)
+    {
+      static constexpr uint64_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+      skipSpace();
+      bool neg = p < end && *p == '-';
+      p += neg;
+      uint64_t v = 0;
+      int total = 0;
+      for (;;)
+      {
+        int len = 0;
+        uint64_t chunk = 0;
+        if (end - p >= 8)
+          chunk = parseDigits8(p, len);
+        else
+          for (; len < 8 && p + len < end && p[len] >= '0' && p[len] <= '9'; len++)
+            chunk = chunk * 10 + (p[len] - '0');
+        total += len;
+        // 19 digits still fit, more may not
+        if (total > 19)
+          return false;
+        v = v * POW10[len] + chunk;
+        p += len;
+        if (len < 8)
+          break;
+      }
+      if (!total || v > (uint64_t)INT64_MAX || (p < end && (*p == '.' || *p == 'e' || *p == 'E')))
+        return false;
+      out = neg ? -(int64_t)v : (int64_t)v;
+      return true;
+    }
+
+    bool levelBook()
+    {
+      if (!consume('{'))
+        return false;
+      do
+      {
+        std::string_view key;
+        if (!string(key) || !consume(':'))
+          return false;
+        auto *side = key == "bids" ? &bids : key == "asks" ? &asks : nullptr;
+        if (!side || !levels(*side))
+          return false;
+      } while (consume(','));
+      return consume('}');
+    }
+
+    bool levels(exchange_core::FixedVector<Level, MAX_LEVELS> &out)
+    {
+      if (!consume('['))
+        return false;
+      if (consume(']'))
+        return true;
+      do
+      {
+        Level level;
+        if (!consume('[') || !integer(level.price) || !consume(',') || !integer(level.quantity) || !consume(']') ||
+            !out.push_back(level))
+          return false;
+      } while (consume(','));
+      return consume(']');
+    }
+
+    bool tradeList()
+    {
+      if (!consume('['))
+        return false;
+      if (consume(']'))
+        return true;
+      do
+      {
+        Trade trade;
+        std::string_view side;
+        if (!consume('[') || !integer(trade.timestamp) || !consume(',') || !string(side) || !consume(',') ||
+            !integer(trade.price) || !consume(',') || !integer(trade.quantity) || !consume(']'))
+          return false;
+        trade.side = side == "Sell" ? exchange_core::Side::SELL : exchange_core::Side::BUY;
+        if (!trades.push_back(trade))
+          return false;
+      } while (consume(','));
+      return consume(']');
+    }
+
+    const char *p = nullptr;
+    const char *end = nullptr;
+    bool book = false;
+    bool has_trades = false;
+    std::string_view symbol;
+    std::string_view type;
+    int64_t timestamp = 0;
+    exchange_core::FixedVector<Level, MAX_LEVELS> bids;
+    exchange_core::FixedVector<Level, MAX_LEVELS> asks;
+    exchange_core::FixedVector<Trade, MAX_TRADES> trades;
+  };
+}
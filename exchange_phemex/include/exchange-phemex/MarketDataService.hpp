@@ -1,5 +1,7 @@
 #pragma once
 #include <exchange-core/exchange-core.h>
+#include <exchange-core/ListenerChain.h>
+#include <exchange-core/PriceLadder.h>
 #include <boost/beast/core.hpp>
 #include <boost/beast/ssl.hpp>
 #include <boost/beast/websocket.hpp>
@@ -9,15 +11,15 @@
 #include <functional>
 #include <iostream>
 #include <string>
-#include <string>
+#include <string_view>
 #include <sstream>
 #include <thread>
 #include <rapidjson/document.h>
 #include <chrono>
 #include <string>
 #include <algorithm>
+#include "FrameScanner.hpp"
 #include "WSConnection.hpp"
-#include <map>
 #include <unordered_map>
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
@@ -29,27 +31,55 @@ using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
 namespace exchange_phemex
 {
-  struct snapshot
+  // Phemex sends prices as priceEp, i.e. scaled by 10000, which is what Price carries for Phemex instruments
+  constexpr int64_t PRICE_EP_SCALE = 10000;
+
+  // BTCUSD's tick of 0.5 in priceEp, used when BTCUSD isn't subscribed with its own metadata
+  constexpr int64_t BTCUSD_TICK_EP = 5000;
+
+  using snapshot = exchange_core::PriceLadder<>;
+
+  // lets the symbol maps be probed with the string_views the parser hands out
+  struct SymbolHash
   {
-    std::map<int, int> bids;
-    std::map<int, int> asks;
+    using is_transparent = void;
+    size_t operator()(std::string_view symbol) const noexcept
+    {
+      return std::hash<std::string_view>()(symbol);
+    }
   };
 
-  class MarketDataService : public exchange_core::MarketDataService, public WSEvent
+  template <class T>
+  using SymbolMap = std::unordered_map<std::string, T, SymbolHash, std::equal_to<>>;
+
+  // a document whose parse stack, too, comes from a pool
+  using InsituDocument = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>, rapidjson::MemoryPoolAllocator<>>;
+
+  // Listener gets onOrderBook()/onTrade() called directly, so with an exchange_core::ListenerChain the callbacks
+  // inline into the parser; MarketDataService below keeps the runtime-registered virtual listeners
+  template <class Listener>
+  class BasicMarketDataService : public exchange_core::MarketDataService, public WSEvent
   {
   public:
-    MarketDataService()
+    explicit BasicMarketDataService(Listener listener = Listener())
+        : listener_(listener)
     {
     }
-    ~MarketDataService()
+    ~BasicMarketDataService()
     {
     }
 
     virtual void Connect()
     {
-      symbolToId["BTCUSD"] = 1;
-      symbolToId["BTC_USDT"] = 1;
-      symbolToId["BTCUSD"] = 1;
+      // what the subscriptions below ask for, unless Subscribe() brought the instruments' own metadata
+      exchange_core::Instrument btcusd;
+      btcusd.symbol = "BTCUSD";
+      btcusd.instrument_id = 1;
+      btcusd.price_scale = PRICE_EP_SCALE;
+      btcusd.tick_size = BTCUSD_TICK_EP;
+      instruments_.try_emplace(btcusd.symbol, btcusd);
+      btcusd.symbol = "BTC_USDT";
+      instruments_.try_emplace(btcusd.symbol, btcusd);
 
       ws_session = std::make_shared<session>(ioc, ctx);
       ws_session->add_listener(this);
@@ -61,7 +91,7 @@ namespace exchange_phemex
     void RunOnce()
     {
       ioc.poll_one();
-      long current_time = exchange_core::currentTimeInMilli();
+      long current_time = clock_.update() / 1000000;
       if (current_time > last_heartbeat_time_ + 29000)
       {
         send_heartbeat();
@@ -69,9 +99,17 @@ namespace exchange_phemex
       }
     }
 
+    // records the instrument's id and tick size, e.g. from a SecurityMaster; an instrument without a tick size,
+    // e.g. from a CSV without the column, keeps the one already known for its symbol
     virtual void Subscribe(exchange_core::Instrument &instr)
     {
-      //      subscribes.push_back(instr);
+      auto &known = instruments_[instr.symbol];
+      int64_t tick = known.tick_size;
+      known = instr;
+      if (known.tick_size <= 0)
+        known.tick_size = tick;
+      if (instr.price_scale != PRICE_EP_SCALE)
+        spdlog::warn("{} has price scale {}, but its book and trade prices are published in priceEp", instr.symbol, instr.price_scale);
     }
     virtual void Unsubscribe(exchange_core::Instrument &instr)
     {
@@ -79,7 +117,13 @@ namespace exchange_phemex
 
     void RegisterListener(exchange_core::MarketDataEventListener &listener)
     {
-      listeners.push_back(&listener);
+      if (!exchange_core::addListener(listener_, listener))
+        spdlog::error("the listeners of this market data service are fixed at compile time");
+    }
+
+    Listener &getListener()
+    {
+      return listener_;
     }
 
     void onConnect()
@@ -97,138 +141,163 @@ namespace exchange_phemex
       needReconnect_ = true;
     }
 
+    // copies into frame_, whose capacity is kept, for the in-situ parse
     void onMessage(const string &msg)
     {
-      spdlog::info("WebSocket message, {}", msg);
-
-      rapidjson::Document doc;
+      frame_.assign(msg);
+      onMessage(frame_.data(), frame_.size());
+    }
 
-      doc.Parse(msg.c_str());
+    // Book and trades frames go through the FrameScanner straight into the ladder, anything else, or a frame it
+    // doesn't take, is parsed in place: the document's strings point into data, its values and parse stack come
+    // from pools that are reset rather than freed. Incremental frames fit the pools, so they don't allocate; a
+    // frame that outgrows them, e.g. a full snapshot deeper than the scanner takes, gets heap chunks that the next
+    // frame's Clear() frees again
+    void onMessage(char *data, std::size_t size)
+    {
+      spdlog::debug("WebSocket message, {}", std::string_view(data, size));
 
-      if (doc.HasMember("book"))
+      if (scanner_.scan(data, size))
       {
-        auto & book = doc["book"];
-        std::string type = doc["type"].GetString();
-        std::string symbol = doc["symbol"].GetString();
+        onScanned();
+        return;
+      }
 
-        if ( type == "snapshot")
-        {
-           auto iter = snapshot_map_.find(symbol);
-
-          if ( iter == snapshot_map_.end())
-          {
-            snapshot_map_.insert(std::make_pair(symbol, snapshot()));
-            iter = snapshot_map_.find(symbol);
-          }
-
-          auto & s = iter->second;
-          s.bids.clear();
-          s.asks.clear();
-          const rapidjson::Value &bids = book["bids"];
-          for (rapidjson::SizeType i = 0; i < bids.Size(); i++)
-          {
-            const rapidjson::Value &d = bids[i];
-            int price = d[0].GetInt64();
-            int qty = d[1].GetInt64();
-            s.bids[price] = qty;
-          }
-          const rapidjson::Value &asks = book["asks"];
-          for (rapidjson::SizeType i = 0; i < asks.Size(); i++)
-          {
-            const rapidjson::Value &d = asks[i];
-            int price = d[0].GetInt64();
-            int qty = d[1].GetInt64();
-            s.asks[price] = qty;
-          }
-        }
-        else if ( type == "incremental")
-        {
-          auto iter = snapshot_map_.find(symbol);
-
-          if ( iter == snapshot_map_.end())
-          {
-            spdlog::error("cannot find snapshot for {}", symbol);
-          }
-
-          auto & s = iter->second;
-          const rapidjson::Value &bids = book["bids"];
-          for (rapidjson::SizeType i = 0; i < bids.Size(); i++)
-          {
-            const rapidjson::Value &d = bids[i];
-            int price = d[0].GetInt64();
-            int qty = d[1].GetInt64();
-            if ( qty == 0)
-            {
-              s.bids.erase(price);
-            }
-            else {
-              s.bids[price] = qty;
-            }
-          }
-          const rapidjson::Value &asks = book["asks"];
-          for (rapidjson::SizeType i = 0; i < asks.Size(); i++)
-          {
-            const rapidjson::Value &d = asks[i];
-            int price = d[0].GetInt64();
-            int qty = d[1].GetInt64();
-            s.asks[price] = qty;
-            if ( qty == 0)
-            {
-              s.asks.erase(price);
-            }
-            else {
-              s.asks[price] = qty;
-            }
-          }
+      doc_.SetNull();
+      valueAllocator_.Clear();
+      stackAllocator_.Clear();
+      doc_.ParseInsitu(data);
+      if (doc_.HasParseError() || !doc_.IsObject())
+        return;
 
+      auto book = doc_.FindMember("book");
+      auto trades = doc_.FindMember("trades");
+      if (book == doc_.MemberEnd() && trades == doc_.MemberEnd())
+        return;
+      std::string_view symbol = stringOf(doc_, "symbol");
 
+      if (book != doc_.MemberEnd())
+      {
+        snapshot *s = bookFor(symbol, stringOf(doc_, "type"));
+        if (!s)
+          return;
+        const rapidjson::Value &bids = book->value["bids"];
+        for (rapidjson::SizeType i = 0; i < bids.Size(); i++)
+        {
+          const rapidjson::Value &d = bids[i];
+          s->set(exchange_core::Side::BUY, d[0].GetInt64(), d[1].GetInt64());
         }
-
-        exchange_core::OrderBook orderBook;
-        orderBook.exchange = exchange_core::ExchangeEnum::PHEMEX;
-        orderBook.timestamp = doc["timestamp"].GetInt64()/1000000;
-        orderBook.instrumentId = symbolToId[symbol];
-        exchange_core::FeedPriceLevel level;
-        level.price = snapshot_map_[symbol].bids.rbegin()->first/10000.;
-        level.quantity = snapshot_map_[symbol].bids.rbegin()->second;
-        level.number_of_order = 1;
-        orderBook.bids.push_back(level);
-        level.price = snapshot_map_[symbol].asks.begin()->first/10000.;
-        level.quantity = snapshot_map_[symbol].asks.begin()->second;
-        level.number_of_order = 1;
-        orderBook.asks.push_back(level);
-
-        for (auto listener : listeners)
+        const rapidjson::Value &asks = book->value["asks"];
+        for (rapidjson::SizeType i = 0; i < asks.Size(); i++)
         {
-          listener->onOrderBook(orderBook);
+          const rapidjson::Value &d = asks[i];
+          s->set(exchange_core::Side::SELL, d[0].GetInt64(), d[1].GetInt64());
         }
+        publishBook(*s, symbol, doc_["timestamp"].GetInt64());
       }
-      if (doc.HasMember("trades"))
+      if (trades != doc_.MemberEnd())
       {
-        auto & trades = doc["trades"];
-        std::string type = doc["type"].GetString();
-        std::string symbol = doc["symbol"].GetString();
-
-        for (rapidjson::SizeType i = 0; i < trades.Size(); i++)
+        const rapidjson::Value &ts = trades->value;
+        int instrument_id = instrumentId(symbol);
+        for (rapidjson::SizeType i = 0; i < ts.Size(); i++)
         {
-          const rapidjson::Value &d = trades[i];
-          exchange_core::FeedTrade trade;
-          trade.exchange = exchange_core::ExchangeEnum::PHEMEX;
-          trade.price = d[2].GetInt64()/10000.;
-          trade.quantity = d[3].GetInt64();
-          trade.side = d[1].GetString() == "Sell" ? exchange_core::Side::SELL : exchange_core::Side::BUY;
-          trade.timestamp = d[0].GetInt64()/1000000;
-          trade.instrument_id = symbolToId[symbol];
-  
-          for (auto listener : listeners)
-          {
-            listener->onTrade(trade);
-          }
+          const rapidjson::Value &d = ts[i];
+          publishTrade(instrument_id, d[0].GetInt64(), stringOf(d[1]) == "Sell" ? exchange_core::Side::SELL : exchange_core::Side::BUY,
+                       d[2].GetInt64(), d[3].GetInt64());
         }
       }
     }
 
   private :
+  void onScanned()
+  {
+    std::string_view symbol = scanner_.getSymbol();
+    if (scanner_.isBook())
+    {
+      snapshot *s = bookFor(symbol, scanner_.getType());
+      if (!s)
+        return;
+      for (auto &l : scanner_.getBids())
+        s->set(exchange_core::Side::BUY, l.price, l.quantity);
+      for (auto &l : scanner_.getAsks())
+        s->set(exchange_core::Side::SELL, l.price, l.quantity);
+      publishBook(*s, symbol, scanner_.getTimestamp());
+    }
+    else
+    {
+      int instrument_id = instrumentId(symbol);
+      for (auto &t : scanner_.getTrades())
+        publishTrade(instrument_id, t.timestamp, t.side, t.price, t.quantity);
+    }
+  }
+
+  // the ladder levels of a book frame go to, cleared for a snapshot; nullptr for an update without a snapshot
+  snapshot *bookFor(std::string_view symbol, std::string_view type)
+  {
+    auto iter = snapshot_map_.find(symbol);
+    if ( type == "snapshot")
+    {
+      if ( iter == snapshot_map_.end())
+      {
+        // the ladder is indexed on the tick grid in priceEp, as the frames carry it, not on instr.price_scale;
+        // without the tick it falls back to a grid of 1 priceEp, where levels far from the touch overflow
+        auto instr = instruments_.find(symbol);
+        int64_t tick = instr != instruments_.end() ? instr->second.tick_size : 0;
+        if (tick <= 0)
+        {
+          spdlog::warn("no tick size configured for {}, its book uses a tick of 1 priceEp", symbol);
+          tick = 1;
+        }
+        // the ladder is large, it's allocated once per symbol and never copied
+        iter = snapshot_map_.emplace(symbol, std::make_unique<snapshot>(tick)).first;
+      }
+      iter->second->clear();
+    }
+    else if ( iter == snapshot_map_.end())
+    {
+      spdlog::error("cannot find snapshot for {}", symbol);
+      return nullptr;
+    }
+    return iter->second.get();
+  }
+
+  // refills the member book, delivering it doesn't allocate
+  void publishBook(const snapshot &s, std::string_view symbol, int64_t timestamp)
+  {
+    exchange_core::fillOrderBook(orderBook_, exchange_core::ExchangeEnum::PHEMEX, instrumentId(symbol), timestamp / 1000000, s);
+    listener_.onOrderBook(orderBook_);
+  }
+
+  void publishTrade(int instrument_id, int64_t timestamp, exchange_core::Side side, int64_t price, int64_t quantity)
+  {
+    exchange_core::FeedTrade trade;
+    trade.exchange = exchange_core::ExchangeEnum::PHEMEX;
+    trade.price = exchange_core::Price(price);
+    trade.quantity = exchange_core::Qty(quantity);
+    trade.side = side;
+    trade.timestamp = timestamp / 1000000;
+    trade.instrument_id = instrument_id;
+
+    listener_.onTrade(trade);
+  }
+
+  static std::string_view stringOf(const rapidjson::Value &v)
+  {
+    return v.IsString() ? std::string_view(v.GetString(), v.GetStringLength()) : std::string_view();
+  }
+
+  static std::string_view stringOf(const rapidjson::Value &v, const char *name)
+  {
+    auto it = v.FindMember(name);
+    return it != v.MemberEnd() ? stringOf(it->value) : std::string_view();
+  }
+
+  int instrumentId(std::string_view symbol) const
+  {
+    auto it = instruments_.find(symbol);
+    return it != instruments_.end() ? it->second.instrument_id : 0;
+  }
+
   void sendSubscription()
   {
     long id = exchange_core::currentTimeInMilli();
@@ -251,7 +320,7 @@ namespace exchange_phemex
     ws_session->send(text);
   }
 
-  std::vector<exchange_core::MarketDataEventListener *> listeners;
+  Listener listener_;
   //    vector<exchange_core::Instrument> > subscribes_;
 
   net::io_context ioc;
@@ -264,11 +333,25 @@ namespace exchange_phemex
   string const bookSub = R"({"id":#, "method":"orderbook.subscribe", "params":["BTCUSD"]})";
   string const tradeSub = R"({"id":#, "method":"trade.subscribe", "params":["BTCUSD"]})";
   string const heartBeat = R"({"id":#, "method":"server.ping", "params":[]})";
-  std::unordered_map<std::string, int> symbolToId;
+  SymbolMap<exchange_core::Instrument> instruments_;
 
   long last_heartbeat_time_{0};
+  // read once per RunOnce
+  exchange_core::CoarseClock clock_;
   long id_ = 1;
 
-  std::unordered_map<std::string, snapshot> snapshot_map_;
+  SymbolMap<std::unique_ptr<snapshot>> snapshot_map_;
+  exchange_core::OrderBook orderBook_;
+
+  // per-frame parsing state, see onMessage()
+  FrameScanner scanner_;
+  std::string frame_;
+  char valueBuffer_[64 * 1024];
+  char stackBuffer_[16 * 1024];
+  rapidjson::MemoryPoolAllocator<> valueAllocator_{valueBuffer_, sizeof(valueBuffer_)};
+  rapidjson::MemoryPoolAllocator<> stackAllocator_{stackBuffer_, sizeof(stackBuffer_)};
+  InsituDocument doc_{&valueAllocator_, 1024, &stackAllocator_};
 };
+
+  using MarketDataService = BasicMarketDataService<exchange_core::MarketDataListeners>;
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <exchange-core/exchange-core.h>
+#include <exchange-core/ListenerChain.h>
 #include <functional>
 #include <spdlog/spdlog.h>
 #include <curl/curl.h>
@@ -37,10 +38,13 @@ using namespace std;
 
 namespace exchange_phemex
 {
-  class TradeService : public exchange_core::TradeService, public WSEvent, public HttpEvent
+  // Listener gets onExecutionReport()/onBalanceReport() called directly, see BasicMarketDataService
+  template <class Listener>
+  class BasicTradeService : public exchange_core::TradeService, public WSEvent, public HttpEvent
   {
   public:
-    TradeService(exchange_core::ExchangeConfig &config) : mConfig(config),
+    BasicTradeService(exchange_core::ExchangeConfig &config, Listener listener = Listener()) : mConfig(config),
+                                                          listener_(listener),
                                                           ws_session(std::make_shared<session>(ioc, ctx)),
                                                           http_session_(std::make_shared<HttpSession>(ioc, ctx))
 
@@ -80,13 +84,19 @@ namespace exchange_phemex
 
     void RegisterListener(exchange_core::TradeEventListener &listener)
     {
-      listeners.push_back(listener);
+      if (!exchange_core::addListener(listener_, listener))
+        spdlog::error("the listeners of this trade service are fixed at compile time");
+    }
+
+    Listener &getListener()
+    {
+      return listener_;
     }
 
     void RunOnce()
     {
       ioc.poll_one();
-      long current_time = exchange_core::currentTimeInMilli();
+      long current_time = clock_.update() / 1000000;
       if ( mNeedReconnect)
       {
         Reconnect();
@@ -143,10 +153,7 @@ namespace exchange_phemex
         er.exchange = exchange_core::ExchangeEnum::PHEMEX;
         er.orderStatus = toOrderStatus(data["ordStatus"].GetString());
 
-        for (exchange_core::TradeEventListener &l : listeners)
-        {
-          l.onExecutionReport(er);
-        }
+        listener_.onExecutionReport(er);
       }
     }
 
@@ -272,10 +279,10 @@ namespace exchange_phemex
       writer.String(side.c_str());
 
       writer.Key(key_price.c_str());
-      writer.Double(order.price);
+      writer.Int64(order.price.raw());
 
       writer.Key(key_quantity.c_str());
-      writer.Double(order.quantity);
+      writer.Int64(order.quantity.raw());
 
       writer.Key(key_tif.c_str());
       writer.String(tif.c_str());
@@ -346,11 +353,12 @@ namespace exchange_phemex
       writer.Key(key_side.c_str());
       writer.String(side.c_str());
 
+      // priceEp is Price's raw value for Phemex instruments, see PRICE_EP_SCALE
       writer.Key(key_price.c_str());
-      writer.Uint64((long)(order.price * 10000));
+      writer.Int64(order.price.raw());
 
       writer.Key(key_quantity.c_str());
-      writer.Uint64((long)order.quantity);
+      writer.Int64(order.quantity.raw());
 
       writer.Key(key_tif.c_str());
       writer.String(tif.c_str());
@@ -529,6 +537,8 @@ namespace exchange_phemex
       ws_session->send(msgstr);
     }
 
+    // order traffic is light, it takes the copying overload
+    using WSEvent::onMessage;
     void onMessage(const std::string &msg)
     {
       spdlog::info("WebSocket message, {}", msg);
@@ -556,10 +566,7 @@ namespace exchange_phemex
           br.currency = a["currency"].GetString();
           br.totalBalance = a["accountBalanceEv"].GetUint64() / 1000000000.;
 
-          for (exchange_core::TradeEventListener &l : listeners)
-          {
-            l.onBalanceReport(br);
-          }
+          listener_.onBalanceReport(br);
         }
       }
       if (doc.HasMember("orders"))
@@ -574,17 +581,14 @@ namespace exchange_phemex
           er.clOrderID = o["clOrdID"].GetString();
           er.orderID = o["orderID"].GetString();
           er.symbol = o["symbol"].GetString();
-          er.lastExecQuantity = o["execQty"].GetUint64();
-          er.lastExecPrice = o["execPriceEp"].GetUint64()/10000.;
-          er.cumQuantity = o["cumQty"].GetUint64();
+          er.lastExecQuantity = exchange_core::Qty(o["execQty"].GetInt64());
+          er.lastExecPrice = exchange_core::Price(o["execPriceEp"].GetInt64());
+          er.cumQuantity = exchange_core::Qty(o["cumQty"].GetInt64());
           er.orderStatus = toOrderStatus(o["ordStatus"].GetString());
           er.side = toSide(o["side"].GetString());
           er.exchange = exchange_core::ExchangeEnum::PHEMEX;
 
-          for (exchange_core::TradeEventListener &l : listeners)
-          {
-            l.onExecutionReport(er);
-          }
+          listener_.onExecutionReport(er);
         }
       }
       if (doc.HasMember("positions"))
@@ -604,10 +608,7 @@ namespace exchange_phemex
             br.totalBalance = -br.totalBalance;
           }
 
-          for (exchange_core::TradeEventListener &l : listeners)
-          {
-            l.onBalanceReport(br);
-          }
+          listener_.onBalanceReport(br);
         }
       }
     }
@@ -758,7 +759,7 @@ namespace exchange_phemex
 
     exchange_core::ExchangeConfig &mConfig;
 
-    std::vector<std::reference_wrapper<exchange_core::TradeEventListener>> listeners;
+    Listener listener_;
 
     net::io_context ioc;
     ssl::context ctx{ssl::context::tlsv12_client};
@@ -783,10 +784,14 @@ namespace exchange_phemex
     bool mNeedReconnect{false};
     bool mHttpNeedReconnect{false};
     long last_heartbeat_time_{0};
+    // read once per RunOnce
+    exchange_core::CoarseClock clock_;
 
     CURL *curl = NULL;
 
     long id_{1000};
     long auth_id_;
   };
+
+  using TradeService = BasicTradeService<exchange_core::TradeListeners>;
 }
@@ -40,6 +40,12 @@ namespace exchange_phemex
   public:
     virtual void onConnect() = 0;
     virtual void onMessage(const std::string & message ) = 0;
+    // the frame in the session's read buffer, NUL terminated and free to be modified, e.g. by an in-situ parse
+    // Only used when the session has a single listener; copies into a string by default
+    virtual void onMessage(char *data, std::size_t size)
+    {
+      onMessage(std::string(data, size));
+    }
     virtual void onClose() = 0;
     virtual void onError(error_code ec) = 0;
   };
@@ -199,12 +205,22 @@ namespace exchange_phemex
       else
       {
         // handle the read here
-        auto message = beast::buffers_to_string(rd_buffer.data());
-        for ( auto l : listeners)
+        std::size_t size = rd_buffer.size();
+        if (listeners.size() == 1)
         {
-          l->onMessage(message);
+          // hand out the frame where it was read, the buffer keeps its capacity across frames
+          static_cast<char *>(rd_buffer.prepare(1).data())[0] = 0;
+          listeners.front()->onMessage(static_cast<char *>(rd_buffer.data().data()), size);
+        }
+        else
+        {
+          auto message = beast::buffers_to_string(rd_buffer.data());
+          for ( auto l : listeners)
+          {
+            l->onMessage(message);
+          }
         }
-        rd_buffer.consume(message.size());
+        rd_buffer.consume(size);
 
         // keep reading until error
         check_read();
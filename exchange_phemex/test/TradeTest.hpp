@@ -65,8 +65,11 @@ TEST(trade, test1)
 
   order.symbol = "BTCUSD";
   order.side = exchange_core::Side::BUY;
-  order.price = 40000.01;
-  order.quantity = 2;
+  exchange_core::Instrument btcusd;
+  btcusd.symbol = "BTCUSD";
+  btcusd.price_scale = exchange_phemex::PRICE_EP_SCALE;
+  order.price = btcusd.toPrice(40000.01);
+  order.quantity = exchange_core::Qty(2);
   order.orderType = exchange_core::OrderType::LIMIT_POST_ONLY;
   order.timeInForce = exchange_core::TimeInForce::GTC;
   